@@ -0,0 +1,267 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "adc.h"
+#include "classify.h"
+#include "kmeans.h"
+#include "kmeans_centers.h"
+#include "model_load.h"
+#include "neural_float.h"
+#include "neural_int8.h"
+#include "neural_network.h"
+
+/*
+ * Micro-benchmarks every classifier variant of the firmware on a labeled
+ * capture. Each variant gets WARMUP untimed passes over all rows, then
+ * `repetitions` timed passes; the median and 99th percentile of the per-pass
+ * time per sample are reported.
+ *
+ *   bench [output_data.txt] [repetitions] [models directory]
+ */
+
+#define MAX_ROWS 1000000
+#define WARMUP 5
+#define DEFAULT_REPETITIONS 101
+
+static int rows;
+static int labels[MAX_ROWS];
+static struct Measurement measurements[MAX_ROWS];
+static int16_t soa_x[MAX_ROWS], soa_y[MAX_ROWS], soa_z[MAX_ROWS];
+static struct measurement_soa soa;
+static uint8_t batch_labels[MAX_ROWS];
+static float centres_float[KMEANS_CLASSES][KMEANS_DIMS];
+static volatile int sink;
+
+// The original float k-means: squared distances in float to dequantized centres
+static int floatNearestCentroid(float x, float y, float z)
+{
+    float best = INFINITY;
+    int winner = 0;
+
+    for (int k = 0; k < KMEANS_CLASSES; k++)
+    {
+        float dx = x - centres_float[k][0];
+        float dy = y - centres_float[k][1];
+        float dz = z - centres_float[k][2];
+        float d = dx * dx + dy * dy + dz * dz;
+
+        if (d < best)
+        {
+            best = d;
+            winner = k;
+        }
+    }
+    return winner;
+}
+
+static int runDouble(void)
+{
+    int correct = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        correct += predictClass(measurements[i].x, measurements[i].y, measurements[i].z) == labels[i];
+    }
+    return correct;
+}
+
+static int runFloat(void)
+{
+    int correct = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        correct += floatPredictClass(measurements[i].x, measurements[i].y, measurements[i].z) == labels[i];
+    }
+    return correct;
+}
+
+static int runInt8(void)
+{
+    int correct = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        correct += quantizedPredictClass(measurements[i].x, measurements[i].y, measurements[i].z) == labels[i];
+    }
+    return correct;
+}
+
+static int countBatch(void)
+{
+    int correct = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        correct += batch_labels[i] == labels[i];
+    }
+    return correct;
+}
+
+static int runDoubleBatch(void)
+{
+    predictClassBatch(&soa, batch_labels);
+    return countBatch();
+}
+
+static int runFloatBatch(void)
+{
+    floatPredictBatch(&soa, batch_labels);
+    return countBatch();
+}
+
+static int runInt8Batch(void)
+{
+    quantizedPredictBatch(&soa, batch_labels);
+    return countBatch();
+}
+
+static int runKmeansFloat(void)
+{
+    int correct = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        correct += floatNearestCentroid(measurements[i].x, measurements[i].y, measurements[i].z) == labels[i];
+    }
+    return correct;
+}
+
+static int runKmeansFixed(void)
+{
+    int correct = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        correct += kmeansNearestCentroid(measurements[i].x, measurements[i].y, measurements[i].z, NULL) == labels[i];
+    }
+    return correct;
+}
+
+static int runKmeansBatch(void)
+{
+    kmeansClassifyBatch(&soa, batch_labels);
+    return countBatch();
+}
+
+static const struct variant
+{
+    const char *name;
+    int (*run)(void);
+} variants[] = {
+    {"nn double", runDouble},
+    {"nn float", runFloat},
+    {"nn int8", runInt8},
+    {"nn double batch", runDoubleBatch},
+    {"nn float batch", runFloatBatch},
+    {"nn int8 batch", runInt8Batch},
+    {"kmeans float", runKmeansFloat},
+    {"kmeans fixed", runKmeansFixed},
+    {"kmeans fixed batch", runKmeansBatch},
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void *loadModel(const char *dir, const char *file, uint8_t type, int (*load)(const struct model_header *))
+{
+    char path[1024];
+    const struct model_header *hdr;
+    void *blob;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    blob = modelLoadFile(path, type, &hdr);
+    if (blob == NULL || load(hdr) != 0)
+    {
+        fprintf(stderr, "%s: cannot load\n", path);
+        exit(1);
+    }
+    return blob;
+}
+
+static int loadCentres(const struct model_header *hdr)
+{
+    const int16_t *q = modelPayload(hdr);
+
+    for (int k = 0; k < KMEANS_CLASSES; k++)
+    {
+        for (int d = 0; d < KMEANS_DIMS; d++)
+        {
+            centres_float[k][d] = q[k * KMEANS_DIMS + d] / (float)(1 << hdr->frac_bits);
+        }
+    }
+    return kmeansLoadModel(hdr);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *data_path = argc > 1 ? argv[1] : "output_data.txt";
+    int repetitions = argc > 2 ? atoi(argv[2]) : DEFAULT_REPETITIONS;
+    const char *models = argc > 3 ? argv[3] : "../nrf5340dk-confusion-matrix/models";
+    double *times;
+    FILE *file;
+    int label, x, y, z;
+
+    loadModel(models, "dense.bin", MODEL_TYPE_DENSE, initializeNeuralNetwork);
+    loadModel(models, "dense.bin", MODEL_TYPE_DENSE, floatNetworkLoad);
+    loadModel(models, "dense_int8.bin", MODEL_TYPE_DENSE, quantizedNetworkLoad);
+    loadModel(models, "kmeans.bin", MODEL_TYPE_KMEANS, loadCentres);
+
+    file = fopen(data_path, "r");
+    if (file == NULL)
+    {
+        perror(data_path);
+        return 1;
+    }
+    while (rows < MAX_ROWS && fscanf(file, "%d %d %d %d", &label, &x, &y, &z) == 4)
+    {
+        labels[rows] = label;
+        measurements[rows] = (struct Measurement){.x = x, .y = y, .z = z};
+        rows++;
+    }
+    fclose(file);
+    if (rows == 0 || repetitions < 1)
+    {
+        fprintf(stderr, "nothing to run\n");
+        return 1;
+    }
+    measurementsToSoa(measurements, rows, soa_x, soa_y, soa_z, &soa);
+
+    times = malloc(repetitions * sizeof(*times));
+    printf("%d rows, %d warmup + %d timed passes per variant\n\n", rows, WARMUP, repetitions);
+    printf("%-20s %12s %12s %14s %9s\n", "variant", "median ns", "p99 ns", "samples/s", "accuracy");
+
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++)
+    {
+        int correct = 0;
+
+        for (int r = 0; r < WARMUP; r++)
+        {
+            sink += variants[v].run();
+        }
+        for (int r = 0; r < repetitions; r++)
+        {
+            double start = now();
+            correct = variants[v].run();
+            times[r] = (now() - start) / rows;
+        }
+        sink += correct;
+
+        qsort(times, repetitions, sizeof(*times), compareDouble);
+        double median = times[repetitions / 2];
+        double p99 = times[(int)ceil(repetitions * 0.99) - 1];
+
+        printf("%-20s %12.1f %12.1f %14.0f %8.1f%%\n", variants[v].name, median, p99, 1e9 / median,
+               100.0 * correct / rows);
+    }
+
+    free(times);
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "kmeans.h"
+#include "kmeans_centers.h"
+#include "model_load.h"
+#include "neural_network.h"
+
+/*
+ * Evaluates the firmware's neural network and k-means classifiers on a
+ * labeled capture of any size (label x y z per line, millivolts).
+ *
+ *   evaluate capture.txt [threads] [dense.bin] [kmeans.bin]
+ *
+ * The file is memory-mapped and split into one newline-aligned slice per
+ * thread. Each thread parses its slice with a plain integer scanner and
+ * fills its own confusion matrices, which are summed at the end, so the
+ * threads share nothing but the read-only models.
+ */
+
+#define CLASSES KMEANS_CLASSES
+#define MAX_THREADS 256
+
+enum classifier
+{
+    NN,
+    KMEANS,
+    CLASSIFIERS
+};
+
+static const char *const classifier_names[CLASSIFIERS] = {"neural network", "k-means"};
+
+struct slice
+{
+    const char *begin;
+    const char *end;
+    uint64_t cm[CLASSIFIERS][CLASSES][CLASSES];
+    uint64_t rows;
+    uint64_t skipped;
+    pthread_t thread;
+};
+
+// Reads an optionally signed integer, ignoring a fractional part
+static const char *parseInt(const char *p, const char *end, long *value)
+{
+    long v = 0;
+    int negative = 0;
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9')
+    {
+        return NULL;
+    }
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        v = v * 10 + (*p++ - '0');
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+        }
+    }
+    *value = negative ? -v : v;
+    return p;
+}
+
+static void *evaluateSlice(void *arg)
+{
+    struct slice *s = arg;
+    const char *p = s->begin;
+
+    while (p < s->end)
+    {
+        const char *line_end = memchr(p, '\n', s->end - p);
+        const char *q = p;
+        long label, x, y, z;
+
+        if (line_end == NULL)
+        {
+            line_end = s->end;
+        }
+
+        if ((q = parseInt(q, line_end, &label)) != NULL && (q = parseInt(q, line_end, &x)) != NULL &&
+            (q = parseInt(q, line_end, &y)) != NULL && (q = parseInt(q, line_end, &z)) != NULL &&
+            label >= 0 && label < CLASSES)
+        {
+            s->cm[NN][label][predictClass(x, y, z)]++;
+            s->cm[KMEANS][label][kmeansNearestCentroid(x, y, z, NULL)]++;
+            s->rows++;
+        }
+        else if (line_end > p && !(line_end - p == 1 && *p == '\r'))
+        {
+            s->skipped++;
+        }
+        p = line_end + 1;
+    }
+    return NULL;
+}
+
+static void printReport(enum classifier c, uint64_t cm[CLASSES][CLASSES])
+{
+    uint64_t total = 0, correct = 0;
+
+    printf("\n%s\n      ", classifier_names[c]);
+    for (int j = 0; j < CLASSES; j++)
+    {
+        printf("%10s%d", "cp", j + 1);
+    }
+    printf("\n");
+    for (int i = 0; i < CLASSES; i++)
+    {
+        printf("cp%d   ", i + 1);
+        for (int j = 0; j < CLASSES; j++)
+        {
+            printf("%11llu", (unsigned long long)cm[i][j]);
+            total += cm[i][j];
+        }
+        correct += cm[i][i];
+        printf("\n");
+    }
+
+    printf("class  precision  recall\n");
+    for (int k = 0; k < CLASSES; k++)
+    {
+        uint64_t predicted = 0, actual = 0;
+
+        for (int i = 0; i < CLASSES; i++)
+        {
+            predicted += cm[i][k];
+            actual += cm[k][i];
+        }
+        printf("cp%d    %9.3f  %6.3f\n", k + 1, predicted ? (double)cm[k][k] / predicted : 0.0,
+               actual ? (double)cm[k][k] / actual : 0.0);
+    }
+    printf("accuracy %.3f\n", total ? (double)correct / total : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dense_path = argc > 3 ? argv[3] : "../nrf5340dk-confusion-matrix/models/dense.bin";
+    const char *kmeans_path = argc > 4 ? argv[4] : "../nrf5340dk-confusion-matrix/models/kmeans.bin";
+    long threads = argc > 2 ? atol(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    static struct slice slices[MAX_THREADS];
+    static uint64_t cm[CLASSIFIERS][CLASSES][CLASSES];
+    const struct model_header *hdr;
+    void *dense, *centres;
+    struct timespec start, end;
+    struct stat st;
+    const char *data, *p;
+    uint64_t rows = 0, skipped = 0;
+    double seconds;
+    int fd;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s capture.txt [threads] [dense.bin] [kmeans.bin]\n", argv[0]);
+        return 2;
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    if (threads > MAX_THREADS)
+    {
+        threads = MAX_THREADS;
+    }
+
+    dense = modelLoadFile(dense_path, MODEL_TYPE_DENSE, &hdr);
+    if (dense == NULL || initializeNeuralNetwork(hdr) != 0)
+    {
+        return 1;
+    }
+    centres = modelLoadFile(kmeans_path, MODEL_TYPE_KMEANS, &hdr);
+    if (centres == NULL || kmeansLoadModel(hdr) != 0)
+    {
+        return 1;
+    }
+
+    fd = open(argv[1], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    if (st.st_size == 0)
+    {
+        fprintf(stderr, "%s is empty\n", argv[1]);
+        return 1;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Cut at roughly equal offsets, moved forward to the next line start
+    p = data;
+    for (long t = 0; t < threads; t++)
+    {
+        const char *cut = data + st.st_size * (t + 1) / threads;
+
+        if (t + 1 < threads && cut > p)
+        {
+            const char *nl = memchr(cut, '\n', data + st.st_size - cut);
+            cut = nl ? nl + 1 : data + st.st_size;
+        }
+        else if (cut < p)
+        {
+            cut = p;
+        }
+        slices[t].begin = p;
+        slices[t].end = cut;
+        p = cut;
+        pthread_create(&slices[t].thread, NULL, evaluateSlice, &slices[t]);
+    }
+
+    for (long t = 0; t < threads; t++)
+    {
+        pthread_join(slices[t].thread, NULL);
+        for (int c = 0; c < CLASSIFIERS; c++)
+        {
+            for (int i = 0; i < CLASSES; i++)
+            {
+                for (int j = 0; j < CLASSES; j++)
+                {
+                    cm[c][i][j] += slices[t].cm[c][i][j];
+                }
+            }
+        }
+        rows += slices[t].rows;
+        skipped += slices[t].skipped;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    for (int c = 0; c < CLASSIFIERS; c++)
+    {
+        printReport(c, cm[c]);
+    }
+
+    printf("\n%llu rows (%llu skipped), %.1f MB in %.3f s on %ld threads: %.0f rows/s\n",
+           (unsigned long long)rows, (unsigned long long)skipped, st.st_size / 1e6, seconds, threads,
+           seconds > 0 ? rows / seconds : 0.0);
+
+    munmap((void *)data, st.st_size);
+    close(fd);
+    free(dense);
+    free(centres);
+    return 0;
+}
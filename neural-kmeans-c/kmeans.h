@@ -1,8 +0,0 @@
-float centroids[6][3] = {
-    {1644.892857142857, 1620.1785714285713, 1956.25},
-    {1664.851851851852, 1948.4814814814815, 1642.5925925925926},
-    {1546.4771563601998, 1728.6864990930521, 1555.0589773250156},
-    {1483.5272727272727, 1632.0, 1467.8545454545454},
-    {1623.0357142857142, 1282.5, 1609.6785714285713},
-    {1969.857142857143, 1602.607142857143, 1620.4285714285713},
-};
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "model_load.h"
+
+void *modelLoadFile(const char *path, uint8_t type, const struct model_header **hdr)
+{
+    FILE *file = fopen(path, "rb");
+    long size;
+    void *blob;
+    int err;
+
+    if (file == NULL)
+    {
+        perror(path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+
+    blob = malloc(size > 0 ? size : 1);
+    if (blob == NULL || fread(blob, 1, size, file) != (size_t)size)
+    {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(file);
+        free(blob);
+        return NULL;
+    }
+    fclose(file);
+
+    err = modelCheck(blob, size, type, hdr);
+    if (err)
+    {
+        fprintf(stderr, "%s: not a valid model of type %d (%s)\n", path, type, strerror(-err));
+        free(blob);
+        return NULL;
+    }
+    return blob;
+}
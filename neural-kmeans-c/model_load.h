@@ -0,0 +1,12 @@
+#ifndef MODEL_LOAD_H
+#define MODEL_LOAD_H
+
+#include "model_format.h"
+
+/* Reads a model blob from path and checks it with modelCheck(). Returns the
+ * blob, to be released with free(), and sets *hdr, or NULL after printing
+ * the reason to stderr.
+ */
+void *modelLoadFile(const char *path, uint8_t type, const struct model_header **hdr);
+
+#endif
@@ -0,0 +1,326 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "model_load.h"
+
+/*
+ * Packs the text model definitions in this directory into the binary blobs
+ * the firmware embeds (see model_format.h).
+ *
+ *   model_pack kmeans <inputs> <frac_bits> centres.txt out.bin
+ *   model_pack dense <inputs> <hidden> <outputs> weights.txt out.bin
+ *   model_pack nearest <inputs> <hidden> <temperature> centres.txt out.bin
+ *   model_pack check kmeans|dense file.bin
+ *   model_pack shell kmeans|dense file.bin
+ *
+ * "nearest" builds a float32 dense model that picks the nearest centre
+ * point, like k-means. Unlike the trained network it reaches every class, so
+ * it is the test case for comparing the network engines.
+ *
+ * "shell" prints the "model begin/data/commit" shell commands that swap the
+ * blob into running firmware built with CONFIG_APP_MODEL_SWAP_SHELL.
+ *
+ * Text files hold whitespace separated numbers; lines starting with # are
+ * comments.
+ */
+
+#define MAX_VALUES 4096
+// Blob bytes per "model data" line, well inside the shell's command buffer
+#define SHELL_CHUNK 48
+
+static int readValues(const char *path, double values[], int max_values)
+{
+    FILE *file = fopen(path, "r");
+    char line[4096];
+    int count = 0;
+
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char *p = line;
+        char *end;
+
+        if (line[0] == '#')
+        {
+            continue;
+        }
+        for (double v = strtod(p, &end); end != p; v = strtod(p, &end))
+        {
+            if (count == max_values)
+            {
+                fprintf(stderr, "%s: more than %d values\n", path, max_values);
+                fclose(file);
+                return -1;
+            }
+            values[count++] = v;
+            p = end;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+static int writeModel(const char *path, struct model_header *hdr, const void *payload)
+{
+    size_t size = sizeof(*hdr) + hdr->payload_size;
+    unsigned char *blob = malloc(size);
+    const struct model_header *checked;
+    FILE *file;
+
+    hdr->magic = MODEL_MAGIC;
+    hdr->version = MODEL_FORMAT_VERSION;
+    hdr->crc32 = modelCrc32(payload, hdr->payload_size);
+    memcpy(blob, hdr, sizeof(*hdr));
+    memcpy(blob + sizeof(*hdr), payload, hdr->payload_size);
+
+    // Same check the firmware runs at boot
+    if (modelCheck(blob, size, hdr->type, &checked) != 0)
+    {
+        fprintf(stderr, "%s: packed model fails its own check\n", path);
+        free(blob);
+        return 1;
+    }
+
+    file = fopen(path, "wb");
+    if (file == NULL || fwrite(blob, 1, size, file) != size)
+    {
+        perror(path);
+        free(blob);
+        return 1;
+    }
+    fclose(file);
+    free(blob);
+    printf("%s: %d bytes, crc32 %08x\n", path, (int)size, hdr->crc32);
+    return 0;
+}
+
+static int packKmeans(int inputs, int frac_bits, const char *src, const char *dst)
+{
+    static double values[MAX_VALUES];
+    static int16_t centres[MAX_VALUES];
+    struct model_header hdr = {0};
+    int count = readValues(src, values, MAX_VALUES);
+
+    if (count <= 0 || inputs <= 0 || count % inputs != 0)
+    {
+        fprintf(stderr, "%s: expected rows of %d values\n", src, inputs);
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        double q = round(values[i] * (1 << frac_bits));
+
+        if (q < INT16_MIN || q > INT16_MAX)
+        {
+            fprintf(stderr, "%s: value %f does not fit with %d fractional bits\n", src, values[i], frac_bits);
+            return 1;
+        }
+        centres[i] = (int16_t)q;
+    }
+
+    hdr.type = MODEL_TYPE_KMEANS;
+    hdr.quant = MODEL_QUANT_FIXED16;
+    hdr.inputs = inputs;
+    hdr.outputs = count / inputs;
+    hdr.frac_bits = frac_bits;
+    hdr.payload_size = modelPayloadSize(&hdr);
+    return writeModel(dst, &hdr, centres);
+}
+
+static int packDense(int inputs, int hidden, int outputs, const char *src, const char *dst)
+{
+    static double values[MAX_VALUES];
+    static float weights[MAX_VALUES];
+    struct model_header hdr = {0};
+    int count = readValues(src, values, MAX_VALUES);
+
+    hdr.type = MODEL_TYPE_DENSE;
+    hdr.quant = MODEL_QUANT_FLOAT32;
+    hdr.inputs = inputs;
+    hdr.hidden = hidden;
+    hdr.outputs = outputs;
+    hdr.payload_size = modelPayloadSize(&hdr);
+
+    if (hdr.payload_size == 0 || count < 0 || (size_t)count * sizeof(float) != hdr.payload_size)
+    {
+        fprintf(stderr, "%s: %d values, expected %d\n", src, count, (int)(hdr.payload_size / sizeof(float)));
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        weights[i] = (float)values[i];
+    }
+    return writeModel(dst, &hdr, weights);
+}
+
+/*
+ * The nearest centre c_k maximises c_k . x - |c_k|^2 / 2, which is linear in
+ * x. Relative to the mean m of the centres, hidden neuron pairs ReLU(x_i - m_i)
+ * and ReLU(m_i - x_i) pass x - m through exactly for any input, and each
+ * output is ((c_k - m) . (x - m) - |c_k - m|^2 / 2) / temperature. Working
+ * relative to m keeps the weights small, so int8 quantization is not
+ * cancelling large terms; the temperature (in mV^2) sets how sharp the
+ * softmax is. Hidden neurons beyond the 2 * inputs used stay zero.
+ */
+static int packNearest(int inputs, int hidden, double temperature, const char *src, const char *dst)
+{
+    static double values[MAX_VALUES];
+    static float weights[MAX_VALUES];
+    double mean[MAX_VALUES] = {0};
+    struct model_header hdr = {0};
+    int count = readValues(src, values, MAX_VALUES);
+    float *w0, *b0, *w1, *b1;
+    int outputs;
+
+    if (count <= 0 || inputs <= 0 || count % inputs != 0 || hidden < 2 * inputs || temperature <= 0)
+    {
+        fprintf(stderr, "%s: expected rows of %d values, at least %d hidden neurons and a temperature\n", src,
+                inputs, 2 * inputs);
+        return 1;
+    }
+    outputs = count / inputs;
+
+    hdr.type = MODEL_TYPE_DENSE;
+    hdr.quant = MODEL_QUANT_FLOAT32;
+    hdr.inputs = inputs;
+    hdr.hidden = hidden;
+    hdr.outputs = outputs;
+    hdr.payload_size = modelPayloadSize(&hdr);
+    if (hdr.payload_size == 0 || hdr.payload_size > sizeof(weights))
+    {
+        fprintf(stderr, "%s: model too large\n", src);
+        return 1;
+    }
+
+    w0 = weights;
+    b0 = w0 + hidden * inputs;
+    w1 = b0 + hidden;
+    b1 = w1 + outputs * hidden;
+    memset(weights, 0, hdr.payload_size);
+
+    for (int k = 0; k < outputs; k++)
+    {
+        for (int i = 0; i < inputs; i++)
+        {
+            mean[i] += values[k * inputs + i] / outputs;
+        }
+    }
+
+    for (int i = 0; i < inputs; i++)
+    {
+        w0[2 * i * inputs + i] = 1.0f;
+        b0[2 * i] = (float)-mean[i];
+        w0[(2 * i + 1) * inputs + i] = -1.0f;
+        b0[2 * i + 1] = (float)mean[i];
+    }
+
+    for (int k = 0; k < outputs; k++)
+    {
+        double norm = 0;
+
+        for (int i = 0; i < inputs; i++)
+        {
+            double offset = values[k * inputs + i] - mean[i];
+
+            w1[k * hidden + 2 * i] = (float)(offset / temperature);
+            w1[k * hidden + 2 * i + 1] = (float)(-offset / temperature);
+            norm += offset * offset;
+        }
+        b1[k] = (float)(-norm / (2 * temperature));
+    }
+    return writeModel(dst, &hdr, weights);
+}
+
+static int parseType(const char *name)
+{
+    if (strcmp(name, "kmeans") == 0)
+    {
+        return MODEL_TYPE_KMEANS;
+    }
+    if (strcmp(name, "dense") == 0)
+    {
+        return MODEL_TYPE_DENSE;
+    }
+    return -1;
+}
+
+static int printShell(const char *name, const char *path)
+{
+    const struct model_header *hdr;
+    const unsigned char *bytes;
+    void *blob = modelLoadFile(path, parseType(name), &hdr);
+    size_t size;
+
+    if (blob == NULL)
+    {
+        return 1;
+    }
+    bytes = blob;
+    size = sizeof(*hdr) + hdr->payload_size;
+
+    printf("model begin %s %zu\n", name, size);
+    for (size_t i = 0; i < size; i += SHELL_CHUNK)
+    {
+        printf("model data ");
+        for (size_t j = i; j < size && j < i + SHELL_CHUNK; j++)
+        {
+            printf("%02x", bytes[j]);
+        }
+        printf("\n");
+    }
+    printf("model commit\n");
+    free(blob);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 6 && strcmp(argv[1], "kmeans") == 0)
+    {
+        return packKmeans(atoi(argv[2]), atoi(argv[3]), argv[4], argv[5]);
+    }
+    if (argc == 7 && strcmp(argv[1], "dense") == 0)
+    {
+        return packDense(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), argv[5], argv[6]);
+    }
+    if (argc == 7 && strcmp(argv[1], "nearest") == 0)
+    {
+        return packNearest(atoi(argv[2]), atoi(argv[3]), atof(argv[4]), argv[5], argv[6]);
+    }
+    if (argc == 4 && strcmp(argv[1], "check") == 0 && parseType(argv[2]) > 0)
+    {
+        const struct model_header *hdr;
+        void *blob = modelLoadFile(argv[3], parseType(argv[2]), &hdr);
+
+        if (blob == NULL)
+        {
+            return 1;
+        }
+        printf("%s: version %d type %d quant %d, %d -> %d -> %d, frac_bits %d, crc32 %08x\n",
+               argv[3], hdr->version, hdr->type, hdr->quant, hdr->inputs, hdr->hidden,
+               hdr->outputs, hdr->frac_bits, hdr->crc32);
+        free(blob);
+        return 0;
+    }
+    if (argc == 4 && strcmp(argv[1], "shell") == 0 && parseType(argv[2]) > 0)
+    {
+        return printShell(argv[2], argv[3]);
+    }
+
+    fprintf(stderr, "usage: %s kmeans <inputs> <frac_bits> centres.txt out.bin\n"
+                    "       %s dense <inputs> <hidden> <outputs> weights.txt out.bin\n"
+                    "       %s nearest <inputs> <hidden> <temperature> centres.txt out.bin\n"
+                    "       %s check kmeans|dense file.bin\n"
+                    "       %s shell kmeans|dense file.bin\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,315 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "model_load.h"
+
+/*
+ * Quantizes a float32 dense model (model_format.h) to MODEL_QUANT_INT8.
+ * Layer 0 weights get one symmetric scale per neuron. Hidden activations are
+ * calibrated on a labeled capture (label x y z per line) from a high
+ * percentile of their positive values rather than the largest one, so a few
+ * outliers do not cost every other row its resolution; the clipped fraction
+ * is reported. The activation scales are folded into the layer 1 weights,
+ * which then get one symmetric scale for the layer.
+ *
+ * One scale shared by all hidden neurons keeps layer 1 weights precise;
+ * one per neuron keeps small activations precise. Both are tried by running
+ * the int8 arithmetic of the firmware over the capture, and the one with
+ * the smaller logit error against float is written.
+ *
+ *   model_quant dense.bin output_data.txt dense_int8.bin
+ */
+
+#define REQUANT_SHIFT 31
+#define MAX_SIZE 1024
+#define MAX_CALIBRATION_ROWS 100000
+#define CALIBRATION_PERCENTILE 99.9
+// Largest input the int8 engine accepts, as QUANTIZED_MAX_INPUT_MV
+#define MAX_INPUT_MV 8191
+
+struct float_model
+{
+    int inputs, hidden, outputs;
+    const float *w0, *b0, *w1, *b1;
+};
+
+struct int8_model
+{
+    float output_scale;
+    // b0, m0, b1 as stored
+    int32_t words[MAX_SIZE];
+    // w0, w1 as stored
+    int8_t bytes[MAX_SIZE];
+};
+
+static int8_t quantize(double value, double scale)
+{
+    double q = round(value / scale);
+    return (int8_t)(q > 127 ? 127 : (q < -127 ? -127 : q));
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void quantizeModel(const struct float_model *f, const double w0_scale[], const double hidden_scale[],
+                          struct int8_model *q)
+{
+    int hidden = f->hidden, inputs = f->inputs, outputs = f->outputs;
+    double w1_scale = 0;
+
+    for (int j = 0; j < hidden; j++)
+    {
+        for (int k = 0; k < outputs; k++)
+        {
+            w1_scale = fmax(w1_scale, fabs(f->w1[k * hidden + j]) * hidden_scale[j]);
+        }
+    }
+    w1_scale = w1_scale > 0 ? w1_scale / 127 : 1.0 / 127;
+    q->output_scale = (float)w1_scale;
+
+    // int32 tensors: b0, m0, b1
+    for (int j = 0; j < hidden; j++)
+    {
+        double multiplier = round(w0_scale[j] / hidden_scale[j] * pow(2, REQUANT_SHIFT));
+
+        q->words[j] = (int32_t)lround(f->b0[j] / w0_scale[j]);
+        q->words[hidden + j] = (int32_t)fmin(multiplier, INT32_MAX);
+    }
+    for (int k = 0; k < outputs; k++)
+    {
+        q->words[2 * hidden + k] = (int32_t)lround(f->b1[k] / w1_scale);
+    }
+
+    // int8 tensors: w0, w1
+    for (int j = 0; j < hidden; j++)
+    {
+        for (int i = 0; i < inputs; i++)
+        {
+            q->bytes[j * inputs + i] = quantize(f->w0[j * inputs + i], w0_scale[j]);
+        }
+    }
+    for (int k = 0; k < outputs; k++)
+    {
+        for (int j = 0; j < hidden; j++)
+        {
+            q->bytes[hidden * inputs + k * hidden + j] =
+                quantize(f->w1[k * hidden + j] * hidden_scale[j], w1_scale);
+        }
+    }
+}
+
+// Largest difference between float and int8 logits, with the firmware's int8 arithmetic
+static double logitError(const struct float_model *f, const struct int8_model *q, const double (*x)[3], int rows)
+{
+    int hidden = f->hidden, inputs = f->inputs, outputs = f->outputs;
+    const int32_t *b0 = q->words, *m0 = q->words + hidden, *b1 = q->words + 2 * hidden;
+    const int8_t *w0 = q->bytes, *w1 = q->bytes + hidden * inputs;
+    double error = 0;
+
+    for (int r = 0; r < rows; r++)
+    {
+        double h[MAX_SIZE];
+        int32_t h_q[MAX_SIZE];
+
+        for (int j = 0; j < hidden; j++)
+        {
+            double acc = f->b0[j];
+            int32_t acc_q = b0[j];
+
+            for (int i = 0; i < inputs; i++)
+            {
+                double input = fmin(fmax(x[r][i], 0), MAX_INPUT_MV);
+
+                acc += f->w0[j * inputs + i] * x[r][i];
+                acc_q += w0[j * inputs + i] * (int32_t)input;
+            }
+            h[j] = acc > 0 ? acc : 0;
+
+            int64_t scaled = ((int64_t)acc_q * m0[j] + ((int64_t)1 << (REQUANT_SHIFT - 1))) >> REQUANT_SHIFT;
+            h_q[j] = acc_q <= 0 ? 0 : (scaled > 127 ? 127 : (int32_t)scaled);
+        }
+
+        for (int k = 0; k < outputs; k++)
+        {
+            double logit = f->b1[k];
+            int32_t logit_q = b1[k];
+
+            for (int j = 0; j < hidden; j++)
+            {
+                logit += f->w1[k * hidden + j] * h[j];
+                logit_q += w1[k * hidden + j] * h_q[j];
+            }
+            error = fmax(error, fabs(logit - logit_q * (double)q->output_scale));
+        }
+    }
+    return error;
+}
+
+int main(int argc, char *argv[])
+{
+    const struct model_header *hdr;
+    struct model_header out = {0};
+    struct float_model f;
+    static struct int8_model shared, per_neuron;
+    const struct int8_model *best;
+    void *blob;
+    double w0_scale[MAX_SIZE], limit[MAX_SIZE], shared_scale[MAX_SIZE], neuron_scale[MAX_SIZE];
+    double largest = 0, shared_error, neuron_error;
+    static int active[MAX_SIZE];
+    double (*x)[3], *column;
+    unsigned char *packed;
+    FILE *file;
+    int label, rows = 0;
+    long clipped = 0, positive = 0;
+
+    if (argc != 4)
+    {
+        fprintf(stderr, "usage: %s dense.bin calibration.txt dense_int8.bin\n", argv[0]);
+        return 2;
+    }
+
+    blob = modelLoadFile(argv[1], MODEL_TYPE_DENSE, &hdr);
+    if (blob == NULL)
+    {
+        return 1;
+    }
+    if (hdr->quant != MODEL_QUANT_FLOAT32 || hdr->inputs != 3 || hdr->hidden > MAX_SIZE / 4)
+    {
+        fprintf(stderr, "%s: expected a float32 model with 3 inputs\n", argv[1]);
+        return 1;
+    }
+
+    f.inputs = hdr->inputs;
+    f.hidden = hdr->hidden;
+    f.outputs = hdr->outputs;
+    f.w0 = modelPayload(hdr);
+    f.b0 = f.w0 + f.hidden * f.inputs;
+    f.w1 = f.b0 + f.hidden;
+    f.b1 = f.w1 + f.outputs * f.hidden;
+
+    for (int j = 0; j < f.hidden; j++)
+    {
+        w0_scale[j] = 0;
+        for (int i = 0; i < f.inputs; i++)
+        {
+            w0_scale[j] = fmax(w0_scale[j], fabs(f.w0[j * f.inputs + i]));
+        }
+        // An all-zero neuron still needs a non-zero scale
+        w0_scale[j] = w0_scale[j] > 0 ? w0_scale[j] / 127 : 1.0 / 127;
+    }
+
+    x = malloc(MAX_CALIBRATION_ROWS * sizeof(*x));
+    column = malloc(MAX_CALIBRATION_ROWS * sizeof(*column));
+    file = fopen(argv[2], "r");
+    if (file == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+    while (rows < MAX_CALIBRATION_ROWS && fscanf(file, "%d %lf %lf %lf", &label, &x[rows][0], &x[rows][1],
+                                                 &x[rows][2]) == 4)
+    {
+        rows++;
+    }
+    fclose(file);
+    if (rows == 0)
+    {
+        fprintf(stderr, "%s: no usable calibration rows\n", argv[2]);
+        return 1;
+    }
+
+    // Percentile of each neuron's positive activations over the capture
+    for (int j = 0; j < f.hidden; j++)
+    {
+        active[j] = 0;
+        for (int r = 0; r < rows; r++)
+        {
+            double acc = f.b0[j];
+            for (int i = 0; i < f.inputs; i++)
+            {
+                acc += f.w0[j * f.inputs + i] * x[r][i];
+            }
+            if (acc > 0)
+            {
+                column[active[j]++] = acc;
+            }
+        }
+
+        if (active[j] > 0)
+        {
+            qsort(column, active[j], sizeof(*column), compareDouble);
+            limit[j] = column[(int)ceil(active[j] * CALIBRATION_PERCENTILE / 100) - 1];
+            for (int r = 0; r < active[j]; r++)
+            {
+                clipped += column[r] > limit[j];
+            }
+            positive += active[j];
+        }
+        else
+        {
+            // Never active on the capture: cover the neuron's whole input range
+            limit[j] = f.b0[j];
+            for (int i = 0; i < f.inputs; i++)
+            {
+                limit[j] += fmax(f.w0[j * f.inputs + i], 0) * MAX_INPUT_MV;
+            }
+        }
+        largest = fmax(largest, limit[j]);
+    }
+    free(column);
+
+    // Scales below the weight scale would need a multiplier of 2^REQUANT_SHIFT or more
+    for (int j = 0; j < f.hidden; j++)
+    {
+        shared_scale[j] = fmax(largest / 127, w0_scale[j]);
+        neuron_scale[j] = fmax(limit[j] / 127, w0_scale[j]);
+    }
+    quantizeModel(&f, w0_scale, shared_scale, &shared);
+    quantizeModel(&f, w0_scale, neuron_scale, &per_neuron);
+    shared_error = logitError(&f, &shared, (const double (*)[3])x, rows);
+    neuron_error = logitError(&f, &per_neuron, (const double (*)[3])x, rows);
+    best = neuron_error < shared_error ? &per_neuron : &shared;
+    free(x);
+
+    out.magic = MODEL_MAGIC;
+    out.version = MODEL_FORMAT_VERSION;
+    out.type = MODEL_TYPE_DENSE;
+    out.quant = MODEL_QUANT_INT8;
+    out.inputs = f.inputs;
+    out.hidden = f.hidden;
+    out.outputs = f.outputs;
+    out.frac_bits = REQUANT_SHIFT;
+    out.payload_size = modelPayloadSize(&out);
+
+    // Output scale, then the int32 tensors, then the int8 tensors
+    packed = malloc(sizeof(out) + out.payload_size);
+    memcpy(packed + sizeof(out), &best->output_scale, sizeof(float));
+    memcpy(packed + sizeof(out) + sizeof(float), best->words, (2 * f.hidden + f.outputs) * sizeof(int32_t));
+    memcpy(packed + sizeof(out) + sizeof(float) + (2 * f.hidden + f.outputs) * sizeof(int32_t), best->bytes,
+           (f.hidden * f.inputs + f.outputs * f.hidden) * sizeof(int8_t));
+    out.crc32 = modelCrc32(packed + sizeof(out), out.payload_size);
+    memcpy(packed, &out, sizeof(out));
+
+    file = fopen(argv[3], "wb");
+    if (file == NULL || fwrite(packed, 1, sizeof(out) + out.payload_size, file) != sizeof(out) + out.payload_size)
+    {
+        perror(argv[3]);
+        return 1;
+    }
+    fclose(file);
+
+    printf("%s: %d bytes (float32 %d), %d calibration rows\n", argv[3], (int)(sizeof(out) + out.payload_size),
+           (int)(sizeof(*hdr) + hdr->payload_size), rows);
+    printf("%ld of %ld positive activations above the %gth percentile, clipped at 127\n", clipped, positive,
+           CALIBRATION_PERCENTILE);
+    printf("max logit error on the capture: shared activation scale %.3g, per neuron %.3g; using %s\n", shared_error,
+           neuron_error, best == &shared ? "shared" : "per neuron");
+    free(packed);
+    free(blob);
+    return 0;
+}
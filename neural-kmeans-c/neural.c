@@ -1,25 +1,110 @@
 #include <math.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include "model_load.h"
+#include "neural_network.h"
 
-double relu(double x) {
-    return fmax(0.0, x);
+/*
+ * Runs the firmware network (nrf5340dk-confusion-matrix/src/neural.c, layer
+ * sizes from its neural_network.h) on a labeled capture and prints every
+ * prediction, the loss and the accuracy.
+ *
+ *   neuralprediction [dense.bin] [output_data.txt]
+ */
+
+#define MAX_ROWS 100000
+
+double max(double a, double b)
+{
+    return a > b ? a : b;
 }
 
-void softmax(double* x, int length, double* result) {
-    double max = x[0];
-    for (int i = 1; i < length; ++i) {
-        if (x[i] > max) {
-            max = x[i];
+double manual_sparse_categorical_crossentropy(int y_true[], double y_pred[][LAYER_2_NEURONS], int size)
+{
+    double total_loss = 0;
+    double epsilon = 1e-15;
+
+    for (int i = 0; i < size; i++)
+    {
+        int true_label = y_true[i];
+        double predicted_prob = y_pred[i][true_label];
+        predicted_prob = max(predicted_prob, epsilon);
+        total_loss += -log(predicted_prob);
+    }
+
+    return total_loss / size;
+}
+
+double calculate_accuracy(int y_true[], double predictions[][LAYER_2_NEURONS], int size)
+{
+    int correct_predictions = 0;
+    for (int i = 0; i < size; i++)
+    {
+        int predicted_class = get_predicted_class(predictions[i], LAYER_2_NEURONS);
+        if (predicted_class == y_true[i])
+        {
+            correct_predictions++;
         }
     }
+    return (double)correct_predictions / size;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *model_path = argc > 1 ? argv[1] : "../nrf5340dk-confusion-matrix/models/dense.bin";
+    const char *data_path = argc > 2 ? argv[2] : "output_data.txt";
+    const struct model_header *hdr;
+    void *blob = modelLoadFile(model_path, MODEL_TYPE_DENSE, &hdr);
+    const struct dense_f32_model *network;
+    int size = 0;
 
-    double sum = 0.0;
-    for (int i = 0; i < length; ++i) {
-        result[i] = exp(x[i] - max);
-        sum += result[i];
+    if (blob == NULL || initializeNeuralNetwork(hdr) != 0)
+    {
+        fprintf(stderr, "%s does not match neural_network.h\n", model_path);
+        return 1;
     }
+    network = modelPayload(hdr);
 
-    for (int i = 0; i < length; ++i) {
-        result[i] /= sum;
+    double(*x_train_normal)[INPUT_DATA_SIZE] = malloc(MAX_ROWS * sizeof(*x_train_normal));
+    double(*predictions)[LAYER_2_NEURONS] = malloc(MAX_ROWS * sizeof(*predictions));
+    int *y_true = malloc(MAX_ROWS * sizeof(int));
+
+    FILE *file = fopen(data_path, "r");
+    if (file == NULL)
+    {
+        perror("Unable to open the file");
+        return 1;
     }
-}
\ No newline at end of file
+
+    while (size < MAX_ROWS && fscanf(file, "%d %lf %lf %lf", &y_true[size], &x_train_normal[size][0],
+                                     &x_train_normal[size][1], &x_train_normal[size][2]) == 4)
+    {
+        size++;
+    }
+    fclose(file);
+
+    for (int i = 0; i < size; i++)
+    {
+        forward_pass(x_train_normal[i], predictions[i], network);
+
+        printf("Sample %d - Predictions: [", i);
+        for (int j = 0; j < LAYER_2_NEURONS; j++)
+        {
+            printf("%f ", predictions[i][j]);
+        }
+        printf("], True Label: %d\n", y_true[i]);
+    }
+
+    double total_loss = manual_sparse_categorical_crossentropy(y_true, predictions, size);
+    printf("Total loss: %f\n", total_loss);
+
+    double accuracy = calculate_accuracy(y_true, predictions, size);
+    printf("Accuracy: %f\n", accuracy);
+
+    free(blob);
+    free(x_train_normal);
+    free(predictions);
+    free(y_true);
+
+    return 0;
+}
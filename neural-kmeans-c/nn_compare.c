@@ -0,0 +1,331 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "model_load.h"
+#include "neural_float.h"
+#include "neural_int8.h"
+#include "neural_network.h"
+
+/*
+ * Runs the firmware's float and int8 networks against the double reference
+ * and reports how far their outputs are from it: the largest logit,
+ * softmax and margin (winner minus runner-up) errors, top-1 and top-2
+ * agreement, and the largest reference margin at which an engine still
+ * picked another class. Label agreement alone proves nothing for a model
+ * that gives most inputs the same class, so this runs on the capture and on
+ * grids sweeping the capture's range (where model_quant calibrated the int8
+ * activations) and a wider one, counts the classes the reference reaches
+ * and warns about the ones it never does. The double row checks
+ * predictClassWithConfidence() itself: its logits are the reference's, so
+ * only its softmax, margin and class are under test.
+ *
+ *   nn_compare dense.bin dense_int8.bin output_data.txt
+ *
+ * `model_pack nearest` builds a model that reaches every class.
+ */
+
+#define MAX_ROWS 100000
+#define SWEEP_STEPS 21
+#define SWEEP_POINTS (SWEEP_STEPS * SWEEP_STEPS * SWEEP_STEPS)
+// The wide sweep extends past the capture's range by this fraction on each side
+#define WIDE_SWEEP_MARGIN 0.1
+#define SETS 3
+#define REPEATS 200
+
+enum engine
+{
+    DOUBLE,
+    FLOAT,
+    INT8,
+    ENGINES
+};
+
+static const char *const engine_names[ENGINES] = {"double", "float", "int8"};
+
+struct agreement
+{
+    int total;
+    int top1;
+    int top2;
+    double logit_error;
+    double probability_error;
+    double margin_error;
+    // Largest reference margin where the engine picked another class
+    double worst_miss;
+};
+
+struct input_set
+{
+    const char *name;
+    int count;
+    int (*rows)[3];
+    int reached[LAYER_2_NEURONS];
+    struct agreement engines[ENGINES];
+};
+
+static int labels[MAX_ROWS];
+static int capture[MAX_ROWS][3];
+static int sweep[SWEEP_POINTS][3];
+static int wide_sweep[SWEEP_POINTS][3];
+
+static const struct model_header *dense_model;
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void compareEngine(struct agreement *a, const double logits[], const double probabilities[], int winner,
+                          int runner_up, const float engine_logits[], const float engine_probabilities[],
+                          int engine_winner, float engine_margin)
+{
+    double margin = logits[winner] - logits[runner_up];
+
+    a->total++;
+    a->top1 += engine_winner == winner;
+    a->top2 += engine_winner == winner || engine_winner == runner_up;
+    for (int k = 0; k < LAYER_2_NEURONS; k++)
+    {
+        a->logit_error = fmax(a->logit_error, fabs(logits[k] - engine_logits[k]));
+        a->probability_error = fmax(a->probability_error, fabs(probabilities[k] - engine_probabilities[k]));
+    }
+    a->margin_error = fmax(a->margin_error, fabs(margin - engine_margin));
+    if (engine_winner != winner)
+    {
+        a->worst_miss = fmax(a->worst_miss, margin);
+    }
+}
+
+static void compareSet(struct input_set *set)
+{
+    for (int i = 0; i < set->count; i++)
+    {
+        const int *row = set->rows[i];
+        double input[INPUT_DATA_SIZE] = {row[0], row[1], row[2]};
+        float input_float[INPUT_DATA_SIZE] = {row[0], row[1], row[2]};
+        double logits[LAYER_2_NEURONS], probabilities[LAYER_2_NEURONS];
+        float engine_logits[LAYER_2_NEURONS], engine_probabilities[LAYER_2_NEURONS];
+        float margin;
+        int winner, runner_up, engine_winner;
+
+        forward_logits(input, logits, modelPayload(dense_model));
+        for (int k = 0; k < LAYER_2_NEURONS; k++)
+        {
+            probabilities[k] = logits[k];
+        }
+        softmax(probabilities, LAYER_2_NEURONS);
+
+        winner = get_predicted_class(logits, LAYER_2_NEURONS);
+        runner_up = winner == 0 ? 1 : 0;
+        for (int k = 0; k < LAYER_2_NEURONS; k++)
+        {
+            if (k != winner && logits[k] > logits[runner_up])
+            {
+                runner_up = k;
+            }
+        }
+        set->reached[winner]++;
+
+        for (int k = 0; k < LAYER_2_NEURONS; k++)
+        {
+            engine_logits[k] = (float)logits[k];
+        }
+        engine_winner = predictClassWithConfidence(row[0], row[1], row[2], &margin, engine_probabilities);
+        if (engine_winner != predictClass(row[0], row[1], row[2]))
+        {
+            printf("%s %d: double confidence path picks another class\n", set->name, i + 1);
+        }
+        compareEngine(&set->engines[DOUBLE], logits, probabilities, winner, runner_up, engine_logits,
+                      engine_probabilities, engine_winner, margin);
+
+        floatForwardLogits(input_float, engine_logits);
+        engine_winner = floatPredictConfidence(row[0], row[1], row[2], &margin, engine_probabilities);
+        if (engine_winner != floatPredictClass(row[0], row[1], row[2]))
+        {
+            printf("%s %d: float confidence path picks another class\n", set->name, i + 1);
+        }
+        compareEngine(&set->engines[FLOAT], logits, probabilities, winner, runner_up, engine_logits,
+                      engine_probabilities, engine_winner, margin);
+
+        quantizedForwardLogits(row[0], row[1], row[2], engine_logits);
+        engine_winner = quantizedPredictConfidence(row[0], row[1], row[2], &margin, engine_probabilities);
+        if (engine_winner != quantizedPredictClass(row[0], row[1], row[2]))
+        {
+            printf("%s %d: int8 confidence path picks another class\n", set->name, i + 1);
+        }
+        compareEngine(&set->engines[INT8], logits, probabilities, winner, runner_up, engine_logits,
+                      engine_probabilities, engine_winner, margin);
+    }
+}
+
+static void printSet(const struct input_set *set)
+{
+    int missing = 0;
+
+    printf("%s: %d inputs, reference picks per class:", set->name, set->count);
+    for (int k = 0; k < LAYER_2_NEURONS; k++)
+    {
+        printf(" %d", set->reached[k]);
+        missing += set->reached[k] == 0;
+    }
+    printf("\n");
+    if (missing)
+    {
+        printf("  warning: %d of %d classes never picked; the agreement below says nothing about them\n", missing,
+               LAYER_2_NEURONS);
+    }
+
+    for (int e = 0; e < ENGINES; e++)
+    {
+        const struct agreement *a = &set->engines[e];
+
+        printf("  %-6s top-1 %d/%d, top-2 %d/%d, max error: logit %.3g, softmax %.3g, margin %.3g", engine_names[e],
+               a->top1, a->total, a->top2, a->total, a->logit_error, a->probability_error, a->margin_error);
+        if (a->top1 != a->total)
+        {
+            printf(", misses up to margin %.3g", a->worst_miss);
+        }
+        printf("\n");
+    }
+}
+
+// Evenly spaced grid over low..high, widened by margin of the span on every side
+static void fillSweep(int points[][3], const int low[], const int high[], double margin)
+{
+    int from[3], to[3];
+
+    for (int d = 0; d < 3; d++)
+    {
+        int widen = (int)((high[d] - low[d]) * margin);
+
+        from[d] = low[d] - widen < 0 ? 0 : low[d] - widen;
+        to[d] = high[d] + widen > QUANTIZED_MAX_INPUT_MV ? QUANTIZED_MAX_INPUT_MV : high[d] + widen;
+    }
+    for (int p = 0; p < SWEEP_POINTS; p++)
+    {
+        int step[3] = {p % SWEEP_STEPS, p / SWEEP_STEPS % SWEEP_STEPS, p / (SWEEP_STEPS * SWEEP_STEPS)};
+
+        for (int d = 0; d < 3; d++)
+        {
+            points[p][d] = from[d] + (to[d] - from[d]) * step[d] / (SWEEP_STEPS - 1);
+        }
+    }
+}
+
+static double timeEngine(int (*predict)(int x, int y, int z), int n)
+{
+    volatile int sink = 0;
+    double start = seconds();
+
+    for (int r = 0; r < REPEATS; r++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            sink += predict(capture[i][0], capture[i][1], capture[i][2]);
+        }
+    }
+    (void)sink;
+    return (seconds() - start) * 1e9 / ((double)REPEATS * n);
+}
+
+static int runDouble(int x, int y, int z)
+{
+    return predictClass(x, y, z);
+}
+
+static int runFloat(int x, int y, int z)
+{
+    return floatPredictClass(x, y, z);
+}
+
+static int runInt8(int x, int y, int z)
+{
+    return quantizedPredictClass(x, y, z);
+}
+
+int main(int argc, char *argv[])
+{
+    const struct model_header *hdr;
+    void *dense, *int8;
+    FILE *file;
+    int n = 0, correct_double = 0, correct_float = 0, correct_int8 = 0;
+    int low[3] = {QUANTIZED_MAX_INPUT_MV, QUANTIZED_MAX_INPUT_MV, QUANTIZED_MAX_INPUT_MV}, high[3] = {0, 0, 0};
+    static struct input_set sets[SETS];
+
+    if (argc != 4)
+    {
+        fprintf(stderr, "usage: %s dense.bin dense_int8.bin output_data.txt\n", argv[0]);
+        return 2;
+    }
+
+    dense = modelLoadFile(argv[1], MODEL_TYPE_DENSE, &hdr);
+    if (dense == NULL || referenceNetworkLoad(hdr) != 0 || floatNetworkLoad(hdr) != 0)
+    {
+        return 1;
+    }
+    dense_model = hdr;
+    int8 = modelLoadFile(argv[2], MODEL_TYPE_DENSE, &hdr);
+    if (int8 == NULL || quantizedNetworkLoad(hdr) != 0)
+    {
+        return 1;
+    }
+
+    file = fopen(argv[3], "r");
+    if (file == NULL)
+    {
+        perror(argv[3]);
+        return 1;
+    }
+    while (n < MAX_ROWS &&
+           fscanf(file, "%d %d %d %d", &labels[n], &capture[n][0], &capture[n][1], &capture[n][2]) == 4)
+    {
+        for (int d = 0; d < 3; d++)
+        {
+            low[d] = capture[n][d] < low[d] ? capture[n][d] : low[d];
+            high[d] = capture[n][d] > high[d] ? capture[n][d] : high[d];
+        }
+        n++;
+    }
+    fclose(file);
+    if (n == 0)
+    {
+        fprintf(stderr, "%s: no rows\n", argv[3]);
+        return 1;
+    }
+
+    fillSweep(sweep, low, high, 0);
+    fillSweep(wide_sweep, low, high, WIDE_SWEEP_MARGIN);
+
+    sets[0] = (struct input_set){.name = "capture", .count = n, .rows = capture};
+    sets[1] = (struct input_set){.name = "sweep", .count = SWEEP_POINTS, .rows = sweep};
+    sets[2] = (struct input_set){.name = "wide sweep", .count = SWEEP_POINTS, .rows = wide_sweep};
+    for (int s = 0; s < SETS; s++)
+    {
+        compareSet(&sets[s]);
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        correct_double += predictClass(capture[i][0], capture[i][1], capture[i][2]) == labels[i];
+        correct_float += floatPredictClass(capture[i][0], capture[i][1], capture[i][2]) == labels[i];
+        correct_int8 += quantizedPredictClass(capture[i][0], capture[i][1], capture[i][2]) == labels[i];
+    }
+
+    printf("sweep covers x %d..%d, y %d..%d, z %d..%d mV in %d steps per axis; wide sweep %.0f %% more each side\n",
+           low[0], high[0], low[1], high[1], low[2], high[2], SWEEP_STEPS, 100 * WIDE_SWEEP_MARGIN);
+    for (int s = 0; s < SETS; s++)
+    {
+        printSet(&sets[s]);
+    }
+    printf("accuracy   double %.1f %%, float %.1f %%, int8 %.1f %% on the capture labels\n",
+           100.0 * correct_double / n, 100.0 * correct_float / n, 100.0 * correct_int8 / n);
+    printf("time       double %.1f ns, float %.1f ns, int8 %.1f ns per inference\n", timeEngine(runDouble, n),
+           timeEngine(runFloat, n), timeEngine(runInt8, n));
+
+    free(dense);
+    free(int8);
+    return 0;
+}
@@ -0,0 +1,252 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "export_format.h"
+
+/*
+ * Converts a binary capture from the firmware's sample export (see
+ * export_format.h) into the label x y z lines of output_data.txt, and
+ * reports lost frames and the confusion matrix the board saw.
+ *
+ *   sample_decode capture.bin|- [output_data.txt]
+ *
+ * Reads a stream, so it can sit behind a live RTT or UART capture. Bytes
+ * that do not form a frame with a valid CRC are skipped one at a time
+ * until the stream lines up again. Assumes a little-endian host.
+ */
+
+#define MAX_CLASSES 256
+#define READ_SIZE (1 << 16)
+#define LINE_MAX 32
+
+struct stats
+{
+    uint64_t samples;
+    uint64_t headers;
+    uint64_t skipped_bytes;
+    uint64_t lost;
+    uint64_t unclassified;
+    uint64_t cycles;
+    uint32_t timestamp_hz;
+    int classes;
+    int seen_classes;
+    int have_seq;
+    uint16_t next_seq;
+    uint32_t last_timestamp;
+    uint64_t cm[MAX_CLASSES][MAX_CLASSES];
+};
+
+static char out_buf[READ_SIZE * 2];
+static size_t out_len;
+
+static void flushOutput(FILE *out)
+{
+    fwrite(out_buf, 1, out_len, out);
+    out_len = 0;
+}
+
+static char *putUint(char *p, unsigned v)
+{
+    char digits[10];
+    int n = 0;
+
+    do
+    {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n)
+    {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+static void writeLine(FILE *out, const struct export_sample *s)
+{
+    char *p;
+
+    if (out_len + LINE_MAX > sizeof(out_buf))
+    {
+        flushOutput(out);
+    }
+    p = out_buf + out_len;
+    p = putUint(p, s->actual);
+    *p++ = ' ';
+    p = putUint(p, s->x);
+    *p++ = ' ';
+    p = putUint(p, s->y);
+    *p++ = ' ';
+    p = putUint(p, s->z);
+    *p++ = '\n';
+    out_len = p - out_buf;
+}
+
+static int crcOk(const uint8_t *frame)
+{
+    uint8_t copy[EXPORT_FRAME_SIZE];
+
+    memcpy(copy, frame, sizeof(copy));
+    copy[offsetof(struct export_sample, crc8)] = 0;
+    return exportCrc8(copy) == frame[offsetof(struct export_sample, crc8)];
+}
+
+static void onSample(struct stats *st, const struct export_sample *s, FILE *out)
+{
+    if (st->have_seq)
+    {
+        st->lost += (uint16_t)(s->seq - st->next_seq);
+        st->cycles += s->timestamp - st->last_timestamp;
+    }
+    st->have_seq = 1;
+    st->next_seq = s->seq + 1;
+    st->last_timestamp = s->timestamp;
+    st->samples++;
+
+    if (s->predicted != EXPORT_UNCLASSIFIED)
+    {
+        st->cm[s->actual][s->predicted]++;
+        if (s->actual >= st->seen_classes || s->predicted >= st->seen_classes)
+        {
+            st->seen_classes = (s->actual > s->predicted ? s->actual : s->predicted) + 1;
+        }
+    }
+    else
+    {
+        st->unclassified++;
+    }
+    writeLine(out, s);
+}
+
+static void onHeader(struct stats *st, const struct export_header *h)
+{
+    st->headers++;
+    st->timestamp_hz = h->timestamp_hz;
+    st->classes = h->classes;
+    if (st->have_seq)
+    {
+        st->lost += (uint16_t)(h->seq - st->next_seq);
+    }
+    st->have_seq = 1;
+    st->next_seq = h->seq;
+}
+
+// Consumes all complete frames in buf and returns the bytes used
+static size_t decode(struct stats *st, const uint8_t *buf, size_t len, FILE *out)
+{
+    size_t i = 0;
+
+    while (len - i >= EXPORT_FRAME_SIZE)
+    {
+        const uint8_t *f = buf + i;
+
+        if (f[0] == EXPORT_SYNC_SAMPLE && crcOk(f))
+        {
+            struct export_sample s;
+
+            memcpy(&s, f, sizeof(s));
+            onSample(st, &s, out);
+            i += EXPORT_FRAME_SIZE;
+            continue;
+        }
+        else if (f[0] == EXPORT_SYNC_HEADER && crcOk(f))
+        {
+            struct export_header h;
+
+            memcpy(&h, f, sizeof(h));
+            if (h.magic == EXPORT_MAGIC && h.version == EXPORT_FORMAT_VERSION && h.classes > 0)
+            {
+                onHeader(st, &h);
+                i += EXPORT_FRAME_SIZE;
+                continue;
+            }
+        }
+        st->skipped_bytes++;
+        i++;
+    }
+    return i;
+}
+
+static void printSummary(const struct stats *st)
+{
+    // Samples before the first header are kept, the matrix is sized to fit them
+    int classes = st->classes > st->seen_classes ? st->classes : st->seen_classes;
+    uint64_t correct = 0, classified = 0;
+
+    fprintf(stderr, "%llu samples, %llu headers, %llu lost, %llu bytes skipped\n",
+            (unsigned long long)st->samples, (unsigned long long)st->headers,
+            (unsigned long long)st->lost, (unsigned long long)st->skipped_bytes);
+    if (st->timestamp_hz && st->samples > 1)
+    {
+        double seconds = (double)st->cycles / st->timestamp_hz;
+
+        fprintf(stderr, "%.3f s on the board, %.1f samples/s\n", seconds,
+                seconds > 0 ? (st->samples + st->lost - 1) / seconds : 0.0);
+    }
+    if (classes == 0)
+    {
+        return;
+    }
+
+    fprintf(stderr, "confusion matrix (rows true, columns predicted)\n");
+    for (int i = 0; i < classes; i++)
+    {
+        fprintf(stderr, "cp%-3d", i + 1);
+        for (int j = 0; j < classes; j++)
+        {
+            fprintf(stderr, " %8llu", (unsigned long long)st->cm[i][j]);
+            classified += st->cm[i][j];
+        }
+        correct += st->cm[i][i];
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "accuracy %.3f, %llu unclassified\n", classified ? (double)correct / classified : 0.0,
+            (unsigned long long)st->unclassified);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct stats st;
+    static uint8_t buf[READ_SIZE + EXPORT_FRAME_SIZE];
+    size_t len = 0, n;
+    FILE *in, *out;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s capture.bin|- [output_data.txt]\n", argv[0]);
+        return 2;
+    }
+
+    in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "rb");
+    if (in == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (out == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    // Frames split across reads are carried over to the next one
+    while ((n = fread(buf + len, 1, READ_SIZE, in)) > 0)
+    {
+        size_t used;
+
+        len += n;
+        used = decode(&st, buf, len, out);
+        memmove(buf, buf + used, len - used);
+        len -= used;
+    }
+    st.skipped_bytes += len;
+
+    flushOutput(out);
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    printSummary(&st);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef ZEPHYR_SHIM_KERNEL_H
+#define ZEPHYR_SHIM_KERNEL_H
+
+/*
+ * Just enough of <zephyr/kernel.h> for the classification sources in
+ * nrf5340dk-confusion-matrix/src to build on the host. Nothing here is
+ * called on the host; it only has to satisfy the headers.
+ */
+#include <stdint.h>
+
+#define BUILD_ASSERT(expr, ...) _Static_assert(expr, "" __VA_ARGS__)
+
+typedef struct
+{
+    int64_t ticks;
+} k_timeout_t;
+
+#endif
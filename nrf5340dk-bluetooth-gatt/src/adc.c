@@ -1,18 +1,26 @@
+#include <string.h>
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/adc.h>
+#if defined(CONFIG_ADC_NRFX_SAADC)
 #include <hal/nrf_saadc.h>
+#endif
 #include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
 #include <zephyr/sys/printk.h>
 #include <zephyr/sys/util.h>
-#include <zephyr/sys/printk.h>
 #include "adc.h"
+#include "adc_filter.h"
+#include "stage_stats.h"
 
 #if !DT_NODE_EXISTS(DT_PATH(zephyr_user)) || \
 	!DT_NODE_HAS_PROP(DT_PATH(zephyr_user), io_channels)
 #error "No suitable devicetree overlay specified"
 #endif
 
+LOG_MODULE_REGISTER(adc, CONFIG_APP_ADC_LOG_LEVEL);
+
 #define DT_SPEC_AND_COMMA(node_id, prop, idx) \
 	ADC_DT_SPEC_GET_BY_IDX(node_id, idx),
 
@@ -21,6 +29,61 @@ static const struct adc_dt_spec adc_channels[] = {
 			     DT_SPEC_AND_COMMA)
 };
 
+/* Bitmask of all channels above, sampled together in a single SAADC scan. */
+static uint32_t adc_channel_mask;
+/* Position of each channel's sample inside the scan buffer. The driver stores
+ * results in ascending channel id order, not in io-channels order.
+ */
+static uint8_t adc_buffer_index[ARRAY_SIZE(adc_channels)];
+
+/* The SAADC driver only supports hardware oversampling for single channel
+ * sequences, so for the multi-channel scan it is done here instead: each
+ * channel averages 2^adc_oversampling[i] consecutive scans.
+ */
+#define ADC_MAX_OVERSAMPLING CONFIG_APP_ADC_MAX_OVERSAMPLING
+#define ADC_MAX_SCANS BIT(ADC_MAX_OVERSAMPLING)
+
+BUILD_ASSERT(ADC_MAX_OVERSAMPLING <= 4, "Scan buffer is sized for at most 16x oversampling");
+
+static uint8_t adc_oversampling[ARRAY_SIZE(adc_channels)];
+static uint8_t adc_oversampling_max;
+static struct adc_filter adc_filters[ARRAY_SIZE(adc_channels)];
+/* Completed measurements, for throughput figures */
+static atomic_t adc_measurement_count;
+
+/* Raw to millivolt conversion, computed once per channel at init:
+ * mv = (raw * scale + offset) >> ADC_MV_SCALE_SHIFT
+ */
+#define ADC_MV_SCALE_SHIFT 16
+
+struct adc_conversion
+{
+	int32_t scale;
+	int32_t offset;
+};
+
+static struct adc_conversion adc_conversion[ARRAY_SIZE(adc_channels)];
+
+struct adc_accumulator
+{
+	int32_t sum[ARRAY_SIZE(adc_channels)];
+	uint16_t scans;
+};
+
+#if defined(CONFIG_APP_ADC_FILTER_MOVING_AVERAGE)
+#define ADC_DEFAULT_FILTER ADC_FILTER_MOVING_AVERAGE
+#define ADC_DEFAULT_FILTER_PARAM CONFIG_APP_ADC_FILTER_WINDOW
+#elif defined(CONFIG_APP_ADC_FILTER_IIR)
+#define ADC_DEFAULT_FILTER ADC_FILTER_IIR
+#define ADC_DEFAULT_FILTER_PARAM CONFIG_APP_ADC_FILTER_IIR_SHIFT
+#elif defined(CONFIG_APP_ADC_FILTER_MEDIAN)
+#define ADC_DEFAULT_FILTER ADC_FILTER_MEDIAN
+#define ADC_DEFAULT_FILTER_PARAM CONFIG_APP_ADC_FILTER_WINDOW
+#else
+#define ADC_DEFAULT_FILTER ADC_FILTER_NONE
+#define ADC_DEFAULT_FILTER_PARAM 0
+#endif
+
 
 
 
@@ -41,95 +104,512 @@ void printDebugInfo(void)
 
 }
 
+/* Same math as adc_raw_to_millivolts_dt(), folded into a single Q16 factor
+ * so converting a sample is one multiply and one shift.
+ */
+static int computeConversion(size_t i)
+{
+	const struct adc_dt_spec *spec = &adc_channels[i];
+	int32_t full_scale_mv = spec->vref_mv;
+	uint8_t resolution = spec->resolution;
+	int err;
+
+	if (spec->channel_cfg.differential) {
+		resolution -= 1U;
+	}
+
+	err = adc_gain_invert(spec->channel_cfg.gain, &full_scale_mv);
+	if (err < 0 || full_scale_mv <= 0) {
+		return err < 0 ? err : -EINVAL;
+	}
+
+	adc_conversion[i].scale =
+		(int32_t)(((int64_t)full_scale_mv << ADC_MV_SCALE_SHIFT) >> resolution);
+	adc_conversion[i].offset = 0;
+
+	return 0;
+}
+
+static inline int32_t rawToMillivolts(size_t i, int32_t raw)
+{
+	return (raw * adc_conversion[i].scale + adc_conversion[i].offset) >> ADC_MV_SCALE_SHIFT;
+}
+
 int initializeADC(void)
 {
 
     int err;
-	
+
+	adc_channel_mask = 0;
 	for (size_t i = 0U; i < ARRAY_SIZE(adc_channels); i++) {
 		if (!device_is_ready(adc_channels[i].dev)) {
-			printk("ADC controller device not ready\n");
+			LOG_ERR("ADC controller device not ready");
+			return -1;
+		}
+
+		/* A single sequence can only span channels of one controller */
+		if (adc_channels[i].dev != adc_channels[0].dev) {
+			LOG_ERR("Channel #%d is not on the same ADC controller", i);
 			return -1;
 		}
 
 		err = adc_channel_setup_dt(&adc_channels[i]);
 		if (err < 0) {
-			printk("Could not setup channel #%d (%d)\n", i, err);
+			LOG_ERR("Could not setup channel #%d (%d)", i, err);
+			return -1;
+		}
+
+		adc_channel_mask |= BIT(adc_channels[i].channel_id);
+	}
+
+	for (size_t i = 0U; i < ARRAY_SIZE(adc_channels); i++) {
+		err = computeConversion(i);
+		if (err < 0) {
+			LOG_ERR("No mV conversion for channel #%d (%d)", i, err);
+			return -1;
+		}
+	}
+
+	for (size_t i = 0U; i < ARRAY_SIZE(adc_channels); i++) {
+		uint32_t lower = adc_channel_mask & (BIT(adc_channels[i].channel_id) - 1U);
+
+		adc_buffer_index[i] = (uint8_t)POPCOUNT(lower);
+
+		/* Build time default comes from zephyr,oversampling in the overlay */
+		err = setADCOversampling(i, MIN(adc_channels[i].oversampling, ADC_MAX_OVERSAMPLING));
+		if (err < 0) {
 			return -1;
 		}
 	}
 
+	err = setADCFilter(ADC_DEFAULT_FILTER, ADC_DEFAULT_FILTER_PARAM);
+	if (err < 0) {
+		LOG_ERR("Invalid ADC filter configuration (%d)", err);
+		return -1;
+	}
+
     return 0;
 
 }
 
+static void storeAxis(struct Measurement *m, size_t axis, int32_t raw, int32_t mv)
+{
+	if (axis == 0) {
+		m->x = mv;
+		m->raw_x = raw;
+	} else if (axis == 1) {
+		m->y = mv;
+		m->raw_y = raw;
+	} else if (axis == 2) {
+		m->z = mv;
+		m->raw_z = raw;
+	}
+}
+
+/* Adds one scan to the oversampling accumulators. Returns true once enough
+ * scans have been collected for every channel.
+ */
+static bool accumulateScan(struct adc_accumulator *acc, const int16_t *buf)
+{
+	for (size_t i = 0U; i < ARRAY_SIZE(adc_channels); i++) {
+		if (acc->scans < BIT(adc_oversampling[i])) {
+			acc->sum[i] += buf[adc_buffer_index[i]];
+		}
+	}
+
+	return ++acc->scans >= BIT(adc_oversampling_max);
+}
+
+/* Decimates, filters and converts the accumulated scans to millivolts, then
+ * clears the accumulator. Safe to call from ISR context.
+ */
+static struct Measurement finishMeasurement(struct adc_accumulator *acc)
+{
+	struct Measurement m = {0};
+
+	for (size_t i = 0U; i < ARRAY_SIZE(adc_channels); i++) {
+		int32_t raw = acc->sum[i] >> adc_oversampling[i];
+
+		raw = adcFilterApply(&adc_filters[i], raw);
+		storeAxis(&m, i, raw, rawToMillivolts(i, raw));
+	}
+
+	*acc = (struct adc_accumulator){0};
+	atomic_inc(&adc_measurement_count);
+	return m;
+}
+
+#if defined(CONFIG_APP_ADC_STREAM)
+
+#define STREAM_BLOCK_SIZE CONFIG_APP_ADC_STREAM_BLOCK_SIZE
+#define STREAM_RING_SIZE CONFIG_APP_ADC_STREAM_RING_SIZE
+#define STREAM_RING_MASK (STREAM_RING_SIZE - 1U)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(STREAM_RING_SIZE),
+	     "CONFIG_APP_ADC_STREAM_RING_SIZE must be a power of two");
+BUILD_ASSERT(STREAM_RING_SIZE >= 2 * STREAM_BLOCK_SIZE,
+	     "Ring buffer must hold at least two blocks");
+
+/* SAADC EasyDMA target, rewritten by every scan */
+static int16_t stream_scan[ARRAY_SIZE(adc_channels)];
+static struct adc_accumulator stream_acc;
+/* Ping-pong blocks filled from the sampling callback */
+static struct Measurement stream_blocks[2][STREAM_BLOCK_SIZE];
+static uint8_t stream_active_block;
+static size_t stream_fill;
+
+/* Single producer (ADC callback) / single consumer ring buffer. The indices
+ * run freely and are only masked on access, so head - tail is the fill level.
+ */
+static struct Measurement stream_ring[STREAM_RING_SIZE];
+static atomic_t stream_head;
+static atomic_t stream_tail;
+static atomic_t stream_overruns;
+static K_SEM_DEFINE(stream_data_sem, 0, 1);
+
+static struct Measurement stream_latest;
+static atomic_t stream_running;
+static atomic_t stream_stop_requested;
+static struct adc_sequence_options stream_options;
+static struct adc_sequence stream_sequence;
+static struct k_poll_signal stream_done = K_POLL_SIGNAL_INITIALIZER(stream_done);
+
+static void streamPublishBlock(const struct Measurement *block)
+{
+	uint32_t head = (uint32_t)atomic_get(&stream_head);
+	uint32_t tail = (uint32_t)atomic_get(&stream_tail);
+
+	if (STREAM_RING_SIZE - (head - tail) < STREAM_BLOCK_SIZE) {
+		/* Consumer is too slow, drop the whole block rather than
+		 * stalling the sampling clock.
+		 */
+		atomic_inc(&stream_overruns);
+		return;
+	}
+
+	for (size_t i = 0U; i < STREAM_BLOCK_SIZE; i++) {
+		stream_ring[(head + i) & STREAM_RING_MASK] = block[i];
+	}
+	atomic_set(&stream_head, (atomic_val_t)(head + STREAM_BLOCK_SIZE));
+	k_sem_give(&stream_data_sem);
+}
+
+/* Called by the ADC driver from ISR context after every scan. The sampling
+ * timer keeps running independently of this callback, so the time spent here
+ * or in the consumers does not shift the sampling instants.
+ */
+static enum adc_action streamSampleDone(const struct device *dev,
+					const struct adc_sequence *sequence,
+					uint16_t sampling_index)
+{
+	struct Measurement *block = stream_blocks[stream_active_block];
+
+	ARG_UNUSED(dev);
+	ARG_UNUSED(sequence);
+	ARG_UNUSED(sampling_index);
+
+	if (atomic_get(&stream_stop_requested)) {
+		return ADC_ACTION_FINISH;
+	}
+
+	if (!accumulateScan(&stream_acc, stream_scan)) {
+		return ADC_ACTION_REPEAT;
+	}
+
+	block[stream_fill] = finishMeasurement(&stream_acc);
+	stream_latest = block[stream_fill];
+
+	if (++stream_fill == STREAM_BLOCK_SIZE) {
+		stream_active_block ^= 1U;
+		stream_fill = 0;
+		streamPublishBlock(block);
+	}
+
+	/* Keep sampling into the same scan buffer forever */
+	return ADC_ACTION_REPEAT;
+}
+
+int startADCStream(uint32_t interval_us)
+{
+	int err;
+
+	if (!atomic_cas(&stream_running, 0, 1)) {
+		return -EALREADY;
+	}
+
+	stream_active_block = 0;
+	stream_fill = 0;
+	stream_acc = (struct adc_accumulator){0};
+	atomic_set(&stream_head, 0);
+	atomic_set(&stream_tail, 0);
+	atomic_set(&stream_overruns, 0);
+	atomic_set(&stream_stop_requested, 0);
+	k_sem_reset(&stream_data_sem);
+	k_poll_signal_reset(&stream_done);
+
+	stream_options = (struct adc_sequence_options) {
+		.interval_us = interval_us,
+		.callback = streamSampleDone,
+		.extra_samplings = 0,
+	};
+	stream_sequence = (struct adc_sequence) {
+		.options = &stream_options,
+		.buffer = stream_scan,
+		.buffer_size = sizeof(stream_scan),
+	};
+	(void)adc_sequence_init_dt(&adc_channels[0], &stream_sequence);
+	stream_sequence.channels = adc_channel_mask;
+	stream_sequence.oversampling = 0;
+
+	err = adc_read_async(adc_channels[0].dev, &stream_sequence, &stream_done);
+	if (err < 0) {
+		LOG_ERR("Could not start ADC stream (%d)", err);
+		atomic_set(&stream_running, 0);
+	}
+	return err;
+}
+
+void stopADCStream(void)
+{
+	struct k_poll_event done_event = K_POLL_EVENT_INITIALIZER(
+		K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &stream_done);
+
+	if (!atomic_get(&stream_running)) {
+		return;
+	}
+
+	atomic_set(&stream_stop_requested, 1);
+	(void)k_poll(&done_event, 1, K_FOREVER);
+	atomic_set(&stream_running, 0);
+}
+
+bool isADCStreamRunning(void)
+{
+	return atomic_get(&stream_running) != 0;
+}
+
+size_t readADCStream(struct Measurement *out, size_t max_count, k_timeout_t timeout)
+{
+	uint32_t head = (uint32_t)atomic_get(&stream_head);
+	uint32_t tail = (uint32_t)atomic_get(&stream_tail);
+	size_t count;
+
+	if (head == tail) {
+		if (k_sem_take(&stream_data_sem, timeout) != 0) {
+			return 0;
+		}
+		head = (uint32_t)atomic_get(&stream_head);
+	}
+
+	count = MIN(head - tail, max_count);
+	for (size_t i = 0U; i < count; i++) {
+		out[i] = stream_ring[(tail + i) & STREAM_RING_MASK];
+	}
+	atomic_set(&stream_tail, (atomic_val_t)(tail + count));
+
+	return count;
+}
+
+void flushADCStream(void)
+{
+	atomic_set(&stream_tail, atomic_get(&stream_head));
+	k_sem_reset(&stream_data_sem);
+}
+
+uint32_t getADCStreamOverruns(void)
+{
+	return (uint32_t)atomic_get(&stream_overruns);
+}
+
+#endif /* CONFIG_APP_ADC_STREAM */
+
+uint32_t getADCMeasurementCount(void)
+{
+	return (uint32_t)atomic_get(&adc_measurement_count);
+}
+
+int setADCOversampling(size_t axis, uint8_t oversampling)
+{
+	unsigned int key;
+	uint8_t max = 0;
+
+	if (axis >= ARRAY_SIZE(adc_channels) || oversampling > ADC_MAX_OVERSAMPLING) {
+		return -EINVAL;
+	}
+
+	key = irq_lock();
+	adc_oversampling[axis] = oversampling;
+	for (size_t i = 0U; i < ARRAY_SIZE(adc_channels); i++) {
+		max = MAX(max, adc_oversampling[i]);
+	}
+	adc_oversampling_max = max;
+#if defined(CONFIG_APP_ADC_STREAM)
+	/* Drop a partially accumulated sample taken with the old ratios */
+	stream_acc = (struct adc_accumulator){0};
+#endif
+	irq_unlock(key);
+
+	return 0;
+}
+
+uint8_t getADCOversampling(size_t axis)
+{
+	return axis < ARRAY_SIZE(adc_channels) ? adc_oversampling[axis] : 0;
+}
+
+int setADCFilter(enum adc_filter_type type, uint8_t param)
+{
+	struct adc_filter filter;
+	unsigned int key;
+	int err;
+
+	err = adcFilterInit(&filter, type, param);
+	if (err < 0) {
+		return err;
+	}
+
+	key = irq_lock();
+	for (size_t i = 0U; i < ARRAY_SIZE(adc_channels); i++) {
+		adc_filters[i] = filter;
+	}
+	irq_unlock(key);
+
+	return 0;
+}
+
+static struct Measurement sampleADC(void)
+{
+	int16_t buf[ADC_MAX_SCANS][ARRAY_SIZE(adc_channels)];
+	struct adc_accumulator acc = {0};
+	struct Measurement m = {0};
+	struct adc_sequence_options options = {
+		.extra_samplings = BIT(adc_oversampling_max) - 1U,
+	};
+	struct adc_sequence sequence = {
+		.options = &options,
+		.buffer = buf,
+		.buffer_size = sizeof(buf),
+	};
+	unsigned int key;
+	int err;
+
+#if defined(CONFIG_APP_ADC_STREAM)
+	/* The controller is owned by the stream while it runs */
+	if (isADCStreamRunning()) {
+		unsigned int key = irq_lock();
+
+		m = stream_latest;
+		irq_unlock(key);
+		return m;
+	}
+#endif
+
+	/* Resolution is shared by all channels, so take it from the first one
+	 * and then widen the sequence to every channel. Oversampling is done
+	 * in software, see accumulateScan().
+	 */
+	(void)adc_sequence_init_dt(&adc_channels[0], &sequence);
+	sequence.channels = adc_channel_mask;
+	sequence.oversampling = 0;
+
+	err = adc_read(adc_channels[0].dev, &sequence);
+	if (err < 0) {
+		LOG_WRN("Could not read (%d)", err);
+		return m;
+	}
+
+	for (size_t scan = 0U; scan <= options.extra_samplings; scan++) {
+		(void)accumulateScan(&acc, buf[scan]);
+	}
+
+	/* The filter state is shared with the stream callback */
+	key = irq_lock();
+	m = finishMeasurement(&acc);
+	irq_unlock(key);
+
+	return m;
+}
+
 struct Measurement readADCValue(void)
 {
-	int16_t buf;
-    struct Measurement m;
-    struct adc_sequence sequence = {
-	  .buffer = &buf,
-
-	  .buffer_size = sizeof(buf),
-    };
-
-    printk("ADC reading:\n");
-	for (size_t i = 0U; i < ARRAY_SIZE(adc_channels); i++) 
-    {
-		int err;
-        int32_t val_mv;
-        // For debug use... 
-		/*
-        printk("- %s, channel %d: ",
-		       adc_channels[i].dev->name,
-		       adc_channels[i].channel_id);
-        */
-
-		(void)adc_sequence_init_dt(&adc_channels[i], &sequence);
-
-		err = adc_read(adc_channels[i].dev, &sequence);
-		if (err < 0) {
-			printk("Could not read (%d)\n", err);
+	STAGE_BEGIN(start);
+	struct Measurement m = sampleADC();
+
+	STAGE_END(STAGE_ADC_READ, start);
+	return m;
+}
+
+#if defined(CONFIG_APP_ADC_SHELL)
+
+static const char *const filter_names[] = {
+	[ADC_FILTER_NONE] = "none",
+	[ADC_FILTER_MOVING_AVERAGE] = "average",
+	[ADC_FILTER_IIR] = "iir",
+	[ADC_FILTER_MEDIAN] = "median",
+};
+
+static int cmdAdcShow(const struct shell *sh, size_t argc, char **argv)
+{
+	shell_print(sh, "filter %s %u", filter_names[adc_filters[0].type], adc_filters[0].param);
+	for (size_t i = 0U; i < ARRAY_SIZE(adc_channels); i++) {
+		shell_print(sh, "axis %u oversampling %u (%u scans)", (unsigned int)i,
+			    adc_oversampling[i], (unsigned int)BIT(adc_oversampling[i]));
+	}
+	return 0;
+}
+
+static int cmdAdcFilter(const struct shell *sh, size_t argc, char **argv)
+{
+	unsigned long param = 0;
+	int err = 0;
+
+	for (size_t type = 0U; type < ARRAY_SIZE(filter_names); type++) {
+		if (strcmp(argv[1], filter_names[type]) != 0) {
 			continue;
-		} else {
-            if(i==0)
-            {
-                m.x = val_mv;
-            }
-            else if (i==1)
-            {
-               m.y = val_mv;
-            }
-            else if (i==2)
-            {
-                m.z = val_mv;
-            }           
-			//printk("%"PRId16, buf);
 		}
-
-		
-		val_mv = buf;
-		err = adc_raw_to_millivolts_dt(&adc_channels[i],&val_mv);
-		if (err < 0) 
-        {
-			printk(" (value in mV not available)\n");
-		} 
-        else 
-        {
-			if(i==0)
-            {
-                m.x = val_mv;
-            }
-            else if (i==1)
-            {
-               m.y = val_mv;
-            }
-            else if (i==2)
-            {
-                m.z = val_mv;
-            }           
-            //printk(" = %"PRId32" mV\n", val_mv);
+		if (argc > 2) {
+			param = shell_strtoul(argv[2], 10, &err);
 		}
+		if (err || param > UINT8_MAX ||
+		    setADCFilter((enum adc_filter_type)type, (uint8_t)param) < 0) {
+			shell_error(sh, "average and median take a window of 1..%d, iir a shift of 1..15",
+				    ADC_FILTER_MAX_WINDOW);
+			return -EINVAL;
+		}
+		return 0;
+	}
+
+	shell_error(sh, "filter must be none, average, iir or median");
+	return -EINVAL;
+}
+
+static int cmdAdcOversampling(const struct shell *sh, size_t argc, char **argv)
+{
+	unsigned long axis;
+	unsigned long oversampling = 0;
+	int err = 0;
+
+	axis = shell_strtoul(argv[1], 10, &err);
+	if (!err) {
+		oversampling = shell_strtoul(argv[2], 10, &err);
+	}
+	if (err || oversampling > UINT8_MAX || setADCOversampling(axis, (uint8_t)oversampling) < 0) {
+		shell_error(sh, "axis must be 0..%u and oversampling 0..%d",
+			    (unsigned int)ARRAY_SIZE(adc_channels) - 1U, ADC_MAX_OVERSAMPLING);
+		return -EINVAL;
 	}
-    return m;
+	return 0;
 }
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_adc,
+	SHELL_CMD(show, NULL, "Print the filter and the oversampling per axis", cmdAdcShow),
+	SHELL_CMD_ARG(filter, NULL,
+		      "Set the filter: none | average <window> | iir <shift> | median <window>",
+		      cmdAdcFilter, 2, 1),
+	SHELL_CMD_ARG(oversampling, NULL, "Average 2^n scans per sample: <axis> <n>",
+		      cmdAdcOversampling, 3, 0),
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(adc, &sub_adc, "Accelerometer ADC settings", cmdAdcShow);
+
+#endif
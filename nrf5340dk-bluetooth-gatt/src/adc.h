@@ -1,16 +1,62 @@
 #ifndef ADC_H_KJJ
 #define ADC_H_KJJ
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include "adc_filter.h"
+
+/* x, y and z are in millivolts. The raw_ fields hold the same samples in
+ * ADC counts (after oversampling and filtering) for classifiers that work
+ * in raw units and want to skip the conversion.
+ */
 struct Measurement
 {
    uint16_t x;
    uint16_t y;
    uint16_t z;
+   uint16_t raw_x;
+   uint16_t raw_y;
+   uint16_t raw_z;
 };
 
 int initializeADC(void);
 struct Measurement readADCValue(void);
 void printDebugInfo(void);
+/* Total number of measurements produced since boot */
+uint32_t getADCMeasurementCount(void);
+
+/* Software oversampling per axis (0 = x, 1 = y, 2 = z): each measurement
+ * averages 2^oversampling scans. The build time default is the channel's
+ * zephyr,oversampling devicetree property; "adc oversampling" on the shell
+ * changes it at runtime.
+ */
+int setADCOversampling(size_t axis, uint8_t oversampling);
+uint8_t getADCOversampling(size_t axis);
+/* Selects the filter applied to every channel between the ADC and all
+ * consumers, as APP_ADC_FILTER does at build time and "adc filter" on the
+ * shell at runtime. Resets the filter state.
+ */
+int setADCFilter(enum adc_filter_type type, uint8_t param);
+
+#if defined(CONFIG_APP_ADC_STREAM)
+/* Continuous acquisition: the ADC is re-triggered every interval_us by the
+ * driver's sampling timer and completed blocks of CONFIG_APP_ADC_STREAM_BLOCK_SIZE
+ * measurements are queued for readADCStream(). While the stream runs,
+ * readADCValue() returns the most recent streamed measurement.
+ */
+int startADCStream(uint32_t interval_us);
+void stopADCStream(void);
+bool isADCStreamRunning(void);
+/* Copies up to max_count queued measurements, waiting up to timeout if the
+ * queue is empty. Returns the number of measurements copied.
+ */
+size_t readADCStream(struct Measurement *out, size_t max_count, k_timeout_t timeout);
+void flushADCStream(void);
+/* Number of blocks dropped because the consumer fell behind */
+uint32_t getADCStreamOverruns(void);
+#endif
 
 
 #endif
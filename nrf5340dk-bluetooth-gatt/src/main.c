@@ -20,6 +20,7 @@
 #include "my_lbs.h"
 #include <zephyr/sys/printk.h>
 #include "adc.h"
+#include "stage_stats.h"
 
 static struct bt_le_adv_param *adv_param = BT_LE_ADV_PARAM(
 	(BT_LE_ADV_OPT_CONNECTABLE |
@@ -28,7 +29,7 @@ static struct bt_le_adv_param *adv_param = BT_LE_ADV_PARAM(
 	801,						  /* Max Advertising Interval 500.625ms (801*0.625ms) */
 	NULL);						  /* Set to NULL for undirected advertising */
 
-LOG_MODULE_REGISTER(Lesson4_Exercise2, LOG_LEVEL_INF);
+LOG_MODULE_REGISTER(Lesson4_Exercise2, CONFIG_APP_LOG_LEVEL);
 
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN (sizeof(DEVICE_NAME) - 1)
@@ -46,8 +47,6 @@ LOG_MODULE_REGISTER(Lesson4_Exercise2, LOG_LEVEL_INF);
 #define NOTIFY_INTERVAL 500
 static bool app_button_state;
 static int suunta = 0;
-// app sensor value is streamed over BLE
-static uint32_t app_sensor_value = 0;
 
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -81,54 +80,122 @@ static bool app_button_cb(void)
 	return app_button_state;
 }
 
+#if defined(CONFIG_APP_ADC_STREAM)
+static struct Measurement stream_block[CONFIG_APP_ADC_STREAM_BLOCK_SIZE];
+
+/* Waits for the next streamed block and keeps only the newest measurement
+ * once every NOTIFY_INTERVAL; everything in between is drained so the ring
+ * buffer never overruns. With CONFIG_APP_LBS_STREAM every drained
+ * measurement is also queued for batched notifications.
+ */
+static struct Measurement wait_for_streamed_measurement(void)
+{
+    static int64_t last_notify;
+    struct Measurement m = {0};
+
+    do {
+        size_t count = readADCStream(stream_block, ARRAY_SIZE(stream_block), K_FOREVER);
+
+        if (count > 0) {
+            m = stream_block[count - 1];
+        }
+#if defined(CONFIG_APP_LBS_STREAM)
+        for (size_t i = 0; i < count; i++) {
+            my_lbs_queue_sample(&stream_block[i], suunta);
+        }
+#endif
+    } while (k_uptime_get() - last_notify < NOTIFY_INTERVAL);
+
+    last_notify = k_uptime_get();
+    return m;
+}
+#endif
+
+/* Busy time of the consumer per measurement, from the sample in hand to its
+ * notification, and the part of it spent logging the sample. The difference
+ * is the same loop without per-sample logging; build with
+ * overlay-log-per-sample.conf to compile the per-sample LOG_DBG in.
+ */
+static struct k_spinlock consumer_lock;
+static uint32_t consumer_samples;
+static uint64_t consumer_cycles;
+static uint64_t consumer_log_cycles;
+
+static void consumer_account(uint32_t cycles, uint32_t log_cycles)
+{
+    k_spinlock_key_t key = k_spin_lock(&consumer_lock);
+
+    consumer_samples++;
+    consumer_cycles += cycles;
+    consumer_log_cycles += log_cycles;
+    k_spin_unlock(&consumer_lock, key);
+}
+
+static void consumer_report(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&consumer_lock);
+    uint32_t samples = consumer_samples;
+    uint64_t cycles = consumer_cycles;
+    uint64_t log_cycles = consumer_log_cycles;
+
+    consumer_samples = 0;
+    consumer_cycles = 0;
+    consumer_log_cycles = 0;
+    k_spin_unlock(&consumer_lock, key);
+
+    if (samples == 0)
+    {
+        return;
+    }
+
+    uint32_t with_log = (uint32_t)(k_cyc_to_ns_floor64(cycles / samples) / 1000);
+    uint32_t without_log = (uint32_t)(k_cyc_to_ns_floor64((cycles - log_cycles) / samples) / 1000);
+
+    LOG_INF("Consumer: %u us/sample with per-sample logging (%u samples/s max), "
+            "%u us/sample without (%u samples/s max)",
+            with_log, 1000000 / MAX(with_log, 1), without_log, 1000000 / MAX(without_log, 1));
+}
+
 // thread function
 void send_data_thread(void)
 {
     while (1)
     {
+#if defined(CONFIG_APP_ADC_STREAM)
+        struct Measurement m = wait_for_streamed_measurement();
+#else
         struct Measurement m = readADCValue();
+#endif
+        uint32_t busy_start = k_cycle_get_32();
         int val = gpio_pin_get_dt(&button); 
         if (val < 0) {
-			printk("suunta = %d\n", suunta);
-            printk("Error reading button state: %d\n", val);
+            LOG_ERR("Error reading button state: %d", val);
         }
 
         if (val > 0) {
             if (suunta < 5) {
-				printk("suunta = %d\n", suunta);
                 suunta++;
             } else {
-				printk("suunta = %d\n", suunta);
                 suunta = 1;
             }
+            LOG_INF("suunta = %d", suunta);
         }
 
-        LOG_DBG("x = %d,  y = %d,  z = %d\n", m.x, m.y, m.z);
+        uint32_t log_start = k_cycle_get_32();
 
-        for (int i = 0; i < 4; i++) {
-            if (i == 0) {
-                app_sensor_value = m.x;
-                my_lbs_send_sensor_notify(app_sensor_value);
-                printk("x = %d\n", m.x);
-            }
-            else if (i == 1) {
-                app_sensor_value = m.y;
-                my_lbs_send_sensor_notify(app_sensor_value);
-                printk("y = %d\n", m.y);
-            }
-            else if (i == 2) {
-                app_sensor_value = m.z;
-                my_lbs_send_sensor_notify(app_sensor_value);
-                printk("z = %d\n", m.z);
-            }
-            else if (i == 3) {
-                app_sensor_value = suunta;
-                my_lbs_send_sensor_notify(app_sensor_value);
-                printk("suunta = %d\n", suunta);
-            }
-        }
+        LOG_DBG("x = %d,  y = %d,  z = %d, suunta = %d", m.x, m.y, m.z, suunta);
+        uint32_t log_cycles = k_cycle_get_32() - log_start;
 
+#if !defined(CONFIG_APP_LBS_STREAM)
+        STAGE_BEGIN(notify_start);
+        my_lbs_send_sample(&m, suunta);
+        STAGE_END(STAGE_NOTIFY, notify_start);
+#endif
+        consumer_account(k_cycle_get_32() - busy_start, log_cycles);
+
+#if !defined(CONFIG_APP_ADC_STREAM)
         k_sleep(K_MSEC(NOTIFY_INTERVAL));
+#endif
     }
 }
 
@@ -234,19 +301,33 @@ void main(void)
 	}
 
 	LOG_INF("Advertising successfully started\n");
+
+	if (initializeADC() != 0)
+	{
+		printk("ADC initialization failed!");
+		return;
+	}
+
+#if defined(CONFIG_APP_ADC_STREAM)
+	err = startADCStream(CONFIG_APP_ADC_STREAM_INTERVAL_US);
+	if (err)
+	{
+		LOG_ERR("ADC stream failed to start (err %d)\n", err);
+		return;
+	}
+#endif
+
 	for (;;)
 	{
 		dk_set_led(RUN_STATUS_LED, (++blink_status) % 2);
 		k_sleep(K_MSEC(RUN_LED_BLINK_INTERVAL));
 
-		if (initializeADC() != 0)
-		{
-			printk("ADC initialization failed!");
-			return;
-		}
-
 		struct Measurement m = readADCValue();
-		LOG_INF("x = %d,  y = %d,  z = %d\n", m.x, m.y, m.z);
+		STAGE_BEGIN(log_start);
+
+		LOG_INF("x = %d,  y = %d,  z = %d", m.x, m.y, m.z);
+		consumer_report();
+		STAGE_END(STAGE_LOG, log_start);
 
 		k_sleep(K_MSEC(1000));
 	}
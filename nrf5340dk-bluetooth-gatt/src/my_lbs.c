@@ -23,8 +23,12 @@
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/gatt.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/ring_buffer.h>
 
 #include "adc.h"
+#include "stage_stats.h"
 
 #include "my_lbs.h"
 
@@ -32,6 +36,14 @@ LOG_MODULE_DECLARE(Lesson4_Exercise2);
 
 static bool notify_enabled;
 static bool notify_mysensor_enabled;
+static uint16_t sample_seq;
+/* The one central this peripheral serves. Set and cleared on the Bluetooth
+ * thread under lbs_conn_lock; other threads use lbs_conn_get().
+ */
+static struct bt_conn *lbs_conn;
+static struct k_spinlock lbs_conn_lock;
+static bool notify_conn_enabled;
+static uint8_t conn_profile;
 static bool indicate_enabled;
 static bool button_state;
 static struct my_lbs_cb lbs_cb;
@@ -51,6 +63,11 @@ static void mylbsbc_ccc_mysensor_cfg_changed(const struct bt_gatt_attr *attr, ui
 	notify_mysensor_enabled = (value == BT_GATT_CCC_NOTIFY);
 }
 
+static void mylbsbc_ccc_conn_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	notify_conn_enabled = (value == BT_GATT_CCC_NOTIFY);
+}
+
 // This function is called when a remote device has acknowledged the indication at its host layer
 static void indicate_cb(struct bt_conn *conn, struct bt_gatt_indicate_params *params, uint8_t err)
 {
@@ -110,6 +127,136 @@ static ssize_t read_button(struct bt_conn *conn, const struct bt_gatt_attr *attr
 	return 0;
 }
 
+#if defined(CONFIG_APP_STAGE_STATS)
+/* Little-endian counter frequency followed by count, min, max, mean and the
+ * histogram of every stage, in enum stage order. Longer than the default
+ * ATT MTU, so clients read it with Read Blob.
+ */
+#define STATS_WORDS_PER_STAGE (4 + STAGE_HISTOGRAM_BUCKETS)
+#define STATS_SIZE (sizeof(uint32_t) * (1 + STAGE_COUNT * STATS_WORDS_PER_STAGE))
+
+static ssize_t read_stats(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+						  uint16_t len, uint16_t offset)
+{
+	uint8_t value[STATS_SIZE];
+	uint8_t *p = value;
+
+	sys_put_le32(stageStatsFrequency(), p);
+	p += sizeof(uint32_t);
+
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		struct stage_stats s;
+
+		stageStatsGet(i, &s);
+		sys_put_le32(s.count, p);
+		sys_put_le32(s.min, p + 4);
+		sys_put_le32(s.max, p + 8);
+		sys_put_le32(s.mean, p + 12);
+		p += 16;
+		for (int b = 0; b < STAGE_HISTOGRAM_BUCKETS; b++)
+		{
+			sys_put_le32(s.histogram[b], p);
+			p += sizeof(uint32_t);
+		}
+	}
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+#endif
+
+/* Bluetooth Characteristic Presentation Format types of the fields of
+ * struct my_lbs_sample, in order
+ */
+static const uint8_t sample_format[] = {
+	MY_LBS_SAMPLE_VERSION,
+	sizeof(struct my_lbs_sample),
+	6,
+	0x06, /* seq, uint16 */
+	0x08, /* timestamp, uint32 */
+	0x0e, /* x, sint16 */
+	0x0e, /* y, sint16 */
+	0x0e, /* z, sint16 */
+	0x04, /* direction, uint8 */
+};
+
+static ssize_t read_sample_format(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+								  void *buf, uint16_t len, uint16_t offset)
+{
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, sample_format,
+							 sizeof(sample_format));
+}
+
+static const char *const conn_profile_names[MY_LBS_CONN_PROFILE_COUNT] = {
+	[MY_LBS_CONN_CENTRAL] = "central",
+	[MY_LBS_CONN_LOW_LATENCY] = "low latency",
+	[MY_LBS_CONN_BALANCED] = "balanced",
+	[MY_LBS_CONN_LOW_POWER] = "low power",
+};
+
+/* Intervals in 1.25 ms, timeouts in 10 ms; each timeout is longer than
+ * 2 * (1 + latency) * interval as the spec requires
+ */
+static const struct bt_le_conn_param conn_profiles[MY_LBS_CONN_PROFILE_COUNT] = {
+	[MY_LBS_CONN_LOW_LATENCY] = BT_LE_CONN_PARAM_INIT(6, 6, 0, 400),
+	[MY_LBS_CONN_BALANCED] = BT_LE_CONN_PARAM_INIT(24, 40, 0, 400),
+	[MY_LBS_CONN_LOW_POWER] = BT_LE_CONN_PARAM_INIT(400, 480, 4, 800),
+};
+
+static void conn_report(struct bt_conn *conn, struct my_lbs_conn_report *report)
+{
+	struct bt_conn_info info = {0};
+
+	if (conn)
+	{
+		bt_conn_get_info(conn, &info);
+	}
+	report->profile = conn_profile;
+	report->interval = sys_cpu_to_le16(info.le.interval);
+	report->latency = sys_cpu_to_le16(info.le.latency);
+	report->timeout = sys_cpu_to_le16(info.le.timeout);
+}
+
+static ssize_t read_conn_profile(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+								 void *buf, uint16_t len, uint16_t offset)
+{
+	struct my_lbs_conn_report report;
+
+	conn_report(conn, &report);
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &report, sizeof(report));
+}
+
+static ssize_t write_conn_profile(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+								  const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	if (len != 1U)
+	{
+		LOG_DBG("Write connection profile: Incorrect data length");
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	if (offset != 0)
+	{
+		LOG_DBG("Write connection profile: Incorrect data offset");
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	uint8_t val = *((uint8_t *)buf);
+
+	if (val == MY_LBS_CONN_CENTRAL || val >= MY_LBS_CONN_PROFILE_COUNT)
+	{
+		LOG_DBG("Write connection profile: Incorrect value");
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
+
+	if (my_lbs_set_conn_profile(val))
+	{
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	return len;
+}
+
 /* LED Button Service Declaration */
 BT_GATT_SERVICE_DEFINE(
 	my_lbs_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_LBS),
@@ -127,7 +274,19 @@ BT_GATT_SERVICE_DEFINE(
 						   NULL, NULL),
 
 	BT_GATT_CCC(mylbsbc_ccc_mysensor_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+	BT_GATT_DESCRIPTOR(BT_UUID_LBS_SAMPLE_FORMAT, BT_GATT_PERM_READ, read_sample_format, NULL,
+					   NULL),
+
+	BT_GATT_CHARACTERISTIC(BT_UUID_LBS_CONN_PROFILE,
+						   BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+						   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, read_conn_profile,
+						   write_conn_profile, NULL),
+	BT_GATT_CCC(mylbsbc_ccc_conn_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
 
+	/* Stage timing statistics, last so the attribute indices above stay put */
+	IF_ENABLED(CONFIG_APP_STAGE_STATS,
+			   (BT_GATT_CHARACTERISTIC(BT_UUID_LBS_STATS, BT_GATT_CHRC_READ, BT_GATT_PERM_READ,
+									   read_stats, NULL, NULL),))
 );
 /* function to register application callbacks for the LED and Button characteristics  */
 int my_lbs_init(struct my_lbs_cb *callbacks)
@@ -156,13 +315,331 @@ int my_lbs_send_button_state_indicate(bool button_state)
 	return bt_gatt_indicate(NULL, &ind_params);
 }
 
-/* function to send notifications for the MYSENSOR characteristic */
-int my_lbs_send_sensor_notify(uint32_t sensor_value)
+static void fill_sample(struct my_lbs_sample *sample, const struct Measurement *m,
+						uint8_t direction)
+{
+	sample->seq = sys_cpu_to_le16(sample_seq++);
+	sample->timestamp = sys_cpu_to_le32(k_uptime_get_32());
+	sample->x = sys_cpu_to_le16(m->x);
+	sample->y = sys_cpu_to_le16(m->y);
+	sample->z = sys_cpu_to_le16(m->z);
+	sample->direction = direction;
+}
+
+/* function to send one packed sample as a MYSENSOR notification */
+int my_lbs_send_sample(const struct Measurement *m, uint8_t direction)
+{
+	struct my_lbs_sample sample;
+
+	fill_sample(&sample, m, direction);
+	if (!notify_mysensor_enabled)
+	{
+		return -EACCES;
+	}
+
+	return bt_gatt_notify(NULL, &my_lbs_svc.attrs[7], &sample, sizeof(sample));
+}
+
+#if defined(CONFIG_APP_LBS_STREAM)
+/* Streaming mode: samples are queued in a ring buffer and sent back to back,
+ * as many per notification as the negotiated ATT MTU allows. A notification
+ * goes out as soon as one is full, or CONFIG_APP_LBS_STREAM_FLUSH_MS after
+ * the oldest queued sample otherwise.
+ */
+#define SAMPLE_SIZE sizeof(struct my_lbs_sample)
+#define MAX_PAYLOAD (CONFIG_BT_L2CAP_TX_MTU - 3)
+
+RING_BUF_DECLARE(stream_ring, CONFIG_APP_LBS_STREAM_QUEUE * SAMPLE_SIZE);
+static struct k_spinlock stream_lock;
+static atomic_t stream_dropped;
+
+static void stream_flush(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(stream_work, stream_flush);
+
+/* A reference to the current connection, or NULL. The caller's reference
+ * keeps it valid even if lbs_disconnected() releases lbs_conn meanwhile.
+ */
+static struct bt_conn *lbs_conn_get(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lbs_conn_lock);
+	struct bt_conn *conn = lbs_conn ? bt_conn_ref(lbs_conn) : NULL;
+
+	k_spin_unlock(&lbs_conn_lock, key);
+	return conn;
+}
+
+/* Payload bytes of one notification, a whole number of samples */
+static uint32_t stream_chunk(struct bt_conn *conn)
+{
+	/* A connection that just went down reports an MTU of 0 */
+	uint16_t mtu = MAX(bt_gatt_get_mtu(conn), BT_ATT_DEFAULT_LE_MTU);
+	uint32_t payload = MIN(mtu - 3, MAX_PAYLOAD);
+
+	return payload - payload % SAMPLE_SIZE;
+}
+
+static void stream_flush(struct k_work *work)
+{
+	static uint8_t payload[MAX_PAYLOAD];
+	struct bt_conn *conn = lbs_conn_get();
+	int err = 0;
+
+	while (conn && notify_mysensor_enabled && err != -ENOTCONN)
+	{
+		uint32_t chunk = stream_chunk(conn);
+		k_spinlock_key_t key = k_spin_lock(&stream_lock);
+		uint32_t len = ring_buf_peek(&stream_ring, payload, chunk);
+
+		k_spin_unlock(&stream_lock, key);
+		if (len == 0)
+		{
+			bt_conn_unref(conn);
+			return;
+		}
+
+		STAGE_BEGIN(start);
+		err = bt_gatt_notify(conn, &my_lbs_svc.attrs[7], payload, len);
+
+		STAGE_END(STAGE_NOTIFY, start);
+		if (err == -ENOMEM)
+		{
+			/* Out of TX buffers, try again once the controller caught up */
+			k_work_reschedule(&stream_work, K_MSEC(1));
+			bt_conn_unref(conn);
+			return;
+		}
+
+		key = k_spin_lock(&stream_lock);
+		ring_buf_get(&stream_ring, NULL, len);
+		k_spin_unlock(&stream_lock, key);
+
+		if (err)
+		{
+			LOG_DBG("Stream notification failed (err %d)", err);
+		}
+	}
+
+	if (conn)
+	{
+		bt_conn_unref(conn);
+	}
+
+	/* Nobody listening any more, drop the backlog */
+	k_spinlock_key_t key = k_spin_lock(&stream_lock);
+
+	ring_buf_reset(&stream_ring);
+	k_spin_unlock(&stream_lock, key);
+}
+
+int my_lbs_queue_sample(const struct Measurement *m, uint8_t direction)
 {
+	struct my_lbs_sample sample;
+	struct bt_conn *conn;
+	uint32_t chunk;
+	bool full_chunk;
+	bool queued;
+
+	fill_sample(&sample, m, direction);
 	if (!notify_mysensor_enabled)
 	{
 		return -EACCES;
 	}
+	conn = lbs_conn_get();
+	if (!conn)
+	{
+		return -EACCES;
+	}
+	chunk = stream_chunk(conn);
+	bt_conn_unref(conn);
+
+	k_spinlock_key_t key = k_spin_lock(&stream_lock);
+
+	queued = ring_buf_space_get(&stream_ring) >= SAMPLE_SIZE;
+	if (queued)
+	{
+		ring_buf_put(&stream_ring, (const uint8_t *)&sample, SAMPLE_SIZE);
+	}
+	full_chunk = ring_buf_size_get(&stream_ring) >= chunk;
+	k_spin_unlock(&stream_lock, key);
+
+	if (full_chunk)
+	{
+		k_work_reschedule(&stream_work, K_NO_WAIT);
+	}
+	else
+	{
+		/* Does nothing if a flush is already pending */
+		k_work_schedule(&stream_work, K_MSEC(CONFIG_APP_LBS_STREAM_FLUSH_MS));
+	}
+
+	if (!queued)
+	{
+		atomic_inc(&stream_dropped);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+uint32_t my_lbs_stream_dropped(void)
+{
+	return atomic_get(&stream_dropped);
+}
+
+static void mtu_exchanged(struct bt_conn *conn, uint8_t err,
+						  struct bt_gatt_exchange_params *params)
+{
+	LOG_INF("MTU exchange %s, ATT MTU %u", err ? "failed" : "done", bt_gatt_get_mtu(conn));
+}
+
+static struct bt_gatt_exchange_params mtu_params = {
+	.func = mtu_exchanged,
+};
+
+/* Ask for the largest PDUs and the fastest PHY; the central may refuse any of them */
+static void stream_start(struct bt_conn *conn)
+{
+	int ret = bt_gatt_exchange_mtu(conn, &mtu_params);
+
+	if (ret)
+	{
+		LOG_WRN("MTU exchange not started (err %d)", ret);
+	}
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+	ret = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+	if (ret)
+	{
+		LOG_WRN("Data length update not started (err %d)", ret);
+	}
+#endif
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+	ret = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+	if (ret)
+	{
+		LOG_WRN("PHY update not started (err %d)", ret);
+	}
+#endif
+}
+
+static void stream_stop(void)
+{
+	struct k_work_sync sync;
+
+	k_work_cancel_delayable_sync(&stream_work, &sync);
+
+	k_spinlock_key_t key = k_spin_lock(&stream_lock);
 
-	return bt_gatt_notify(NULL, &my_lbs_svc.attrs[7], &sensor_value, sizeof(sensor_value));
+	ring_buf_reset(&stream_ring);
+	k_spin_unlock(&stream_lock, key);
 }
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+static void stream_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+	LOG_INF("Data length TX %u bytes, RX %u bytes", info->tx_max_len, info->rx_max_len);
+}
+#endif
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+static void stream_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *info)
+{
+	LOG_INF("PHY TX %u, RX %u", info->tx_phy, info->rx_phy);
+}
+#endif
+
+#endif
+
+int my_lbs_set_conn_profile(enum my_lbs_conn_profile profile)
+{
+	int err;
+
+	if (profile == MY_LBS_CONN_CENTRAL || profile >= MY_LBS_CONN_PROFILE_COUNT)
+	{
+		return -EINVAL;
+	}
+	if (!lbs_conn)
+	{
+		return -ENOTCONN;
+	}
+
+	err = bt_conn_le_param_update(lbs_conn, &conn_profiles[profile]);
+	if (err)
+	{
+		LOG_WRN("Connection profile %s not requested (err %d)", conn_profile_names[profile], err);
+		return err;
+	}
+
+	conn_profile = profile;
+	LOG_INF("Requested %s connection profile", conn_profile_names[profile]);
+	return 0;
+}
+
+static void lbs_connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err || lbs_conn)
+	{
+		return;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lbs_conn_lock);
+
+	lbs_conn = bt_conn_ref(conn);
+	k_spin_unlock(&lbs_conn_lock, key);
+	conn_profile = MY_LBS_CONN_CENTRAL;
+
+#if defined(CONFIG_APP_LBS_STREAM)
+	stream_start(conn);
+#endif
+}
+
+static void lbs_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	if (conn != lbs_conn)
+	{
+		return;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lbs_conn_lock);
+
+	lbs_conn = NULL;
+	k_spin_unlock(&lbs_conn_lock, key);
+
+#if defined(CONFIG_APP_LBS_STREAM)
+	/* A flush still running holds its own reference */
+	stream_stop();
+#endif
+	bt_conn_unref(conn);
+}
+
+/* Reports what the central granted, which need not match the profile */
+static void lbs_le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+								 uint16_t timeout)
+{
+	struct my_lbs_conn_report report;
+
+	if (conn != lbs_conn)
+	{
+		return;
+	}
+
+	LOG_INF("Connection interval %u.%02u ms, latency %u, timeout %u ms (%s profile)",
+			interval * 125 / 100, interval * 125 % 100, latency, timeout * 10,
+			conn_profile_names[conn_profile]);
+
+	if (notify_conn_enabled)
+	{
+		conn_report(conn, &report);
+		bt_gatt_notify(conn, &my_lbs_svc.attrs[11], &report, sizeof(report));
+	}
+}
+
+BT_CONN_CB_DEFINE(lbs_conn_callbacks) = {
+	.connected = lbs_connected,
+	.disconnected = lbs_disconnected,
+	.le_param_updated = lbs_le_param_updated,
+#if defined(CONFIG_APP_LBS_STREAM) && defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+	.le_data_len_updated = stream_data_len_updated,
+#endif
+#if defined(CONFIG_APP_LBS_STREAM) && defined(CONFIG_BT_USER_PHY_UPDATE)
+	.le_phy_updated = stream_phy_updated,
+#endif
+};
@@ -18,6 +18,9 @@ extern "C" {
 #endif
 
 #include <zephyr/types.h>
+#include <zephyr/toolchain.h>
+
+struct Measurement;
 
 /** @brief LBS Service UUID. */
 #define BT_UUID_LBS_VAL BT_UUID_128_ENCODE(0x00001523, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
@@ -34,11 +37,83 @@ extern "C" {
 #define BT_UUID_LBS_MYSENSOR_VAL                                                                   \
 	BT_UUID_128_ENCODE(0x00001526, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
 
+/** @brief Sample record format Descriptor UUID. */
+#define BT_UUID_LBS_SAMPLE_FORMAT_VAL                                                              \
+	BT_UUID_128_ENCODE(0x00001528, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief Connection parameter profile Characteristic UUID. */
+#define BT_UUID_LBS_CONN_PROFILE_VAL                                                               \
+	BT_UUID_128_ENCODE(0x00001529, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
+/** @brief Stage timing statistics Characteristic UUID. */
+#define BT_UUID_LBS_STATS_VAL                                                                      \
+	BT_UUID_128_ENCODE(0x00001527, 0x1212, 0xefde, 0x1523, 0x785feabcd123)
+
 #define BT_UUID_LBS BT_UUID_DECLARE_128(BT_UUID_LBS_VAL)
 #define BT_UUID_LBS_BUTTON BT_UUID_DECLARE_128(BT_UUID_LBS_BUTTON_VAL)
 #define BT_UUID_LBS_LED BT_UUID_DECLARE_128(BT_UUID_LBS_LED_VAL)
 /* STEP 11.2 - Convert the array to a generic UUID */
 #define BT_UUID_LBS_MYSENSOR BT_UUID_DECLARE_128(BT_UUID_LBS_MYSENSOR_VAL)
+#define BT_UUID_LBS_STATS BT_UUID_DECLARE_128(BT_UUID_LBS_STATS_VAL)
+#define BT_UUID_LBS_SAMPLE_FORMAT BT_UUID_DECLARE_128(BT_UUID_LBS_SAMPLE_FORMAT_VAL)
+#define BT_UUID_LBS_CONN_PROFILE BT_UUID_DECLARE_128(BT_UUID_LBS_CONN_PROFILE_VAL)
+
+/** @brief Version of the MYSENSOR sample record layout. */
+#define MY_LBS_SAMPLE_VERSION 1
+
+/** @brief One accelerometer sample as sent in a MYSENSOR notification.
+ *
+ * Little-endian and packed. The Sample Format descriptor of the
+ * characteristic holds MY_LBS_SAMPLE_VERSION, sizeof(struct my_lbs_sample),
+ * the number of fields and then a Bluetooth format type per field in this
+ * order, so a central can check the layout before decoding.
+ */
+struct my_lbs_sample {
+	/** Increments by one per sample, gaps mean lost samples. */
+	uint16_t seq;
+	/** Uptime in milliseconds when the sample was taken or, when streaming,
+	 *  queued; not when it went out, which can be up to the stream flush
+	 *  interval later.
+	 */
+	uint32_t timestamp;
+	/** Accelerometer axes in millivolts. */
+	int16_t x;
+	int16_t y;
+	int16_t z;
+	/** Direction selected with the button (suunta). */
+	uint8_t direction;
+} __packed;
+
+/** @brief Connection parameter profiles, written to the Connection Profile
+ * Characteristic as one byte.
+ */
+enum my_lbs_conn_profile {
+	/** Nothing requested, the central's choice stands. Cannot be written. */
+	MY_LBS_CONN_CENTRAL,
+	/** 7.5 ms interval, no peripheral latency, for interactive use. */
+	MY_LBS_CONN_LOW_LATENCY,
+	/** 30-50 ms interval, no peripheral latency. */
+	MY_LBS_CONN_BALANCED,
+	/** 500-600 ms interval, 4 skipped events, for idle monitoring. */
+	MY_LBS_CONN_LOW_POWER,
+	MY_LBS_CONN_PROFILE_COUNT
+};
+
+/** @brief Value of the Connection Profile Characteristic.
+ *
+ * Read it or enable notifications to learn the parameters the central
+ * actually granted, which may differ from the profile.
+ */
+struct my_lbs_conn_report {
+	/** Last requested enum my_lbs_conn_profile. */
+	uint8_t profile;
+	/** Connection interval in units of 1.25 ms. */
+	uint16_t interval;
+	/** Peripheral latency in connection events. */
+	uint16_t latency;
+	/** Supervision timeout in units of 10 ms. */
+	uint16_t timeout;
+} __packed;
 
 /** @brief Callback type for when an LED state change is received. */
 typedef void (*led_cb_t)(const bool led_state);
@@ -69,6 +144,52 @@ struct my_lbs_cb {
  */
 int my_lbs_init(struct my_lbs_cb *callbacks);
 
+/** @brief Send one accelerometer sample as a MYSENSOR notification.
+ *
+ * Fills in the sequence number and timestamp. The sequence number advances
+ * even when the sample cannot be sent, so the central sees the gap.
+ *
+ * @param[in] m Measurement to send.
+ * @param[in] direction Currently selected direction.
+ *
+ * @retval 0 If the operation was successful.
+ *           -EACCES if notifications are not enabled, otherwise a
+ *           (negative) error code from the stack.
+ */
+int my_lbs_send_sample(const struct Measurement *m, uint8_t direction);
+
+/** @brief Queue one accelerometer sample for batched streaming.
+ *
+ * Only with CONFIG_APP_LBS_STREAM. Queued samples are sent back to back,
+ * as many struct my_lbs_sample records per MYSENSOR notification as the
+ * ATT MTU allows, at the latest CONFIG_APP_LBS_STREAM_FLUSH_MS after
+ * queueing.
+ *
+ * @param[in] m Measurement to send.
+ * @param[in] direction Currently selected direction.
+ *
+ * @retval 0 If the sample was queued.
+ *           -EACCES if no central has notifications enabled, -ENOMEM if
+ *           the queue is full. The sequence number advances either way.
+ */
+int my_lbs_queue_sample(const struct Measurement *m, uint8_t direction);
+
+/** @brief Number of samples dropped because the stream queue was full. */
+uint32_t my_lbs_stream_dropped(void);
+
+/** @brief Request the connection parameters of a profile.
+ *
+ * The central answers asynchronously; the negotiated parameters are logged
+ * and notified on the Connection Profile Characteristic.
+ *
+ * @param[in] profile Any profile but MY_LBS_CONN_CENTRAL.
+ *
+ * @retval 0 If the request was sent.
+ *           -EINVAL for an unknown profile, -ENOTCONN without a central,
+ *           otherwise a (negative) error code from the stack.
+ */
+int my_lbs_set_conn_profile(enum my_lbs_conn_profile profile);
+
 /** @brief Send the "hey there" string as indication.
  *
  * This function sends the "hey there" string to all connected peers.
@@ -0,0 +1,63 @@
+#ifndef STAGE_STATS_H_KJJ
+#define STAGE_STATS_H_KJJ
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#if defined(CONFIG_TIMING_FUNCTIONS)
+#include <zephyr/timing/timing.h>
+#endif
+
+/* Code paths that are timed when CONFIG_APP_STAGE_STATS is enabled */
+enum stage {
+	STAGE_ADC_READ,
+	STAGE_CLASSIFY,
+	STAGE_NOTIFY,
+	STAGE_LOG,
+	STAGE_COUNT
+};
+
+#define STAGE_HISTOGRAM_BUCKETS 8
+
+/* One stage, with durations in cycles of stageStatsFrequency(). Histogram
+ * bucket b counts durations below 256 * 4^b cycles; the last bucket also
+ * takes everything longer.
+ */
+struct stage_stats {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint32_t mean;
+	uint32_t histogram[STAGE_HISTOGRAM_BUCKETS];
+};
+
+#if defined(CONFIG_APP_STAGE_STATS)
+
+/* DWT cycle counter through the timing API where available, otherwise the
+ * kernel cycle counter.
+ */
+static inline uint32_t stageTimestamp(void)
+{
+#if defined(CONFIG_TIMING_FUNCTIONS)
+	return (uint32_t)timing_counter_get();
+#else
+	return k_cycle_get_32();
+#endif
+}
+
+void stageRecord(enum stage stage, uint32_t cycles);
+void stageStatsGet(enum stage stage, struct stage_stats *out);
+void stageStatsReset(void);
+uint32_t stageStatsFrequency(void);
+const char *stageName(enum stage stage);
+
+#define STAGE_BEGIN(start) uint32_t start = stageTimestamp()
+#define STAGE_END(stage, start) stageRecord(stage, stageTimestamp() - (start))
+
+#else
+
+#define STAGE_BEGIN(start)
+#define STAGE_END(stage, start)
+
+#endif
+
+#endif
@@ -0,0 +1,98 @@
+#include <errno.h>
+#include <string.h>
+#include "adc_filter.h"
+
+int adcFilterInit(struct adc_filter *f, enum adc_filter_type type, uint8_t param)
+{
+	switch (type) {
+	case ADC_FILTER_NONE:
+		break;
+	case ADC_FILTER_MOVING_AVERAGE:
+	case ADC_FILTER_MEDIAN:
+		if (param == 0 || param > ADC_FILTER_MAX_WINDOW) {
+			return -EINVAL;
+		}
+		break;
+	case ADC_FILTER_IIR:
+		/* y += (x - y) / 2^param */
+		if (param == 0 || param > 15) {
+			return -EINVAL;
+		}
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	memset(f, 0, sizeof(*f));
+	f->type = type;
+	f->param = param;
+	return 0;
+}
+
+static int32_t movingAverage(struct adc_filter *f, int32_t sample)
+{
+	if (f->count == f->param) {
+		f->sum -= f->window[f->pos];
+	} else {
+		f->count++;
+	}
+	f->window[f->pos] = sample;
+	f->sum += sample;
+	f->pos = (f->pos + 1) % f->param;
+
+	return f->sum / f->count;
+}
+
+static int32_t firstOrderIIR(struct adc_filter *f, int32_t sample)
+{
+	int32_t sample_q8 = sample * 256;
+
+	if (f->count == 0) {
+		/* Start from the first sample instead of ramping up from zero */
+		f->iir_q8 = sample_q8;
+		f->count = 1;
+	} else {
+		f->iir_q8 += (sample_q8 - f->iir_q8) >> f->param;
+	}
+
+	return (f->iir_q8 + 128) >> 8;
+}
+
+static int32_t median(struct adc_filter *f, int32_t sample)
+{
+	int32_t sorted[ADC_FILTER_MAX_WINDOW];
+
+	f->window[f->pos] = sample;
+	f->pos = (f->pos + 1) % f->param;
+	if (f->count < f->param) {
+		f->count++;
+	}
+
+	/* Insertion sort, the window is at most a handful of samples */
+	for (uint8_t i = 0; i < f->count; i++) {
+		int32_t v = f->window[i];
+		int j = i - 1;
+
+		while (j >= 0 && sorted[j] > v) {
+			sorted[j + 1] = sorted[j];
+			j--;
+		}
+		sorted[j + 1] = v;
+	}
+
+	return sorted[f->count / 2];
+}
+
+int32_t adcFilterApply(struct adc_filter *f, int32_t sample)
+{
+	switch (f->type) {
+	case ADC_FILTER_MOVING_AVERAGE:
+		return movingAverage(f, sample);
+	case ADC_FILTER_IIR:
+		return firstOrderIIR(f, sample);
+	case ADC_FILTER_MEDIAN:
+		return median(f, sample);
+	default:
+		return sample;
+	}
+}
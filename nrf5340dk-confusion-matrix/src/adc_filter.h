@@ -0,0 +1,38 @@
+#ifndef ADC_FILTER_H_KJJ
+#define ADC_FILTER_H_KJJ
+
+#include <stdint.h>
+
+/* Longest moving average / median window supported by the filter state */
+#define ADC_FILTER_MAX_WINDOW 16
+
+enum adc_filter_type
+{
+   ADC_FILTER_NONE,
+   ADC_FILTER_MOVING_AVERAGE,
+   ADC_FILTER_IIR,
+   ADC_FILTER_MEDIAN,
+};
+
+/* Per-channel filter state. All arithmetic is integer so the filter can run
+ * in the ADC sampling callback.
+ */
+struct adc_filter
+{
+   enum adc_filter_type type;
+   /* Window length for moving average and median, shift for the IIR */
+   uint8_t param;
+   uint8_t pos;
+   uint8_t count;
+   int32_t sum;
+   /* IIR output with 8 fractional bits */
+   int32_t iir_q8;
+   int32_t window[ADC_FILTER_MAX_WINDOW];
+};
+
+/* Returns -EINVAL if param is out of range for the given filter type */
+int adcFilterInit(struct adc_filter *f, enum adc_filter_type type, uint8_t param);
+int32_t adcFilterApply(struct adc_filter *f, int32_t sample);
+
+
+#endif
@@ -0,0 +1,210 @@
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include "adc_replay.h"
+
+#define ADC_REPLAY_NODE DT_IO_CHANNELS_CTLR_BY_IDX(DT_PATH(zephyr_user), 0)
+
+BUILD_ASSERT(DT_NODE_HAS_COMPAT(ADC_REPLAY_NODE, zephyr_adc_emul),
+	     "zephyr,user io-channels must point to a zephyr,adc-emul node");
+
+#define DT_SPEC_AND_COMMA(node_id, prop, idx) \
+	ADC_DT_SPEC_GET_BY_IDX(node_id, idx),
+
+/* The channels adc.c reads, for their gain, reference and resolution */
+static const struct adc_dt_spec replay_channels[] = {
+	DT_FOREACH_PROP_ELEM(DT_PATH(zephyr_user), io_channels,
+			     DT_SPEC_AND_COMMA)
+};
+
+BUILD_ASSERT(ARRAY_SIZE(replay_channels) == 3, "the capture holds x, y and z per row");
+
+static int32_t full_scale_mv[ARRAY_SIZE(replay_channels)];
+
+/* The capture file embedded at build time, see CMakeLists.txt */
+static const char capture[] = {
+#include "adc_replay_capture.inc"
+};
+
+struct replay_row
+{
+	int label;
+	uint32_t mv[3];
+};
+
+static struct replay_row current_row;
+static size_t parse_offset;
+static size_t position;
+static int64_t start_ticks;
+
+static bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/* Reads the next unsigned integer, skipping anything that is not a digit
+ * except line breaks. Returns false at the end of a line or the capture.
+ */
+static bool parseNumber(size_t *offset, uint32_t *value)
+{
+	size_t i = *offset;
+	uint32_t v = 0;
+
+	while (i < sizeof(capture) && !isDigit(capture[i])) {
+		if (capture[i] == '\n') {
+			return false;
+		}
+		i++;
+	}
+	if (i == sizeof(capture)) {
+		return false;
+	}
+
+	while (i < sizeof(capture) && isDigit(capture[i])) {
+		v = v * 10U + (uint32_t)(capture[i] - '0');
+		i++;
+	}
+
+	*offset = i;
+	*value = v;
+	return true;
+}
+
+/* Parses the row starting at parse_offset into current_row and leaves
+ * parse_offset at the start of the following row. Malformed lines are skipped.
+ */
+static bool parseRow(void)
+{
+	while (parse_offset < sizeof(capture)) {
+		size_t offset = parse_offset;
+		uint32_t values[4];
+		size_t count = 0;
+
+		while (count < ARRAY_SIZE(values) && parseNumber(&offset, &values[count])) {
+			count++;
+		}
+
+		while (offset < sizeof(capture) && capture[offset] != '\n') {
+			offset++;
+		}
+		parse_offset = offset + 1;
+
+		if (count == ARRAY_SIZE(values)) {
+			current_row.label = (int)values[0];
+			current_row.mv[0] = values[1];
+			current_row.mv[1] = values[2];
+			current_row.mv[2] = values[3];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void adcReplayRewind(void)
+{
+	parse_offset = 0;
+	position = 0;
+	start_ticks = k_uptime_ticks();
+	if (!parseRow()) {
+		printk("ADC replay capture contains no rows\n");
+	}
+}
+
+bool adcReplayStep(void)
+{
+	if (parseRow()) {
+		position++;
+		return true;
+	}
+
+	adcReplayRewind();
+	return false;
+}
+
+int adcReplayLabel(void)
+{
+	return current_row.label;
+}
+
+size_t adcReplayPosition(void)
+{
+	return position;
+}
+
+/* Smallest count that adc.c converts back to mv. The emulator would round
+ * the recorded millivolts down to a count and adc.c round that down again,
+ * losing 1 mV on some rows. With a step below 1 mV (checked at init) this
+ * count gives mv exactly: mv <= raw * full_scale / 2^resolution < mv + 1.
+ */
+static uint32_t millivoltsToRaw(unsigned int chan, uint32_t mv)
+{
+	uint8_t resolution = replay_channels[chan].resolution;
+	uint64_t raw = (((uint64_t)mv << resolution) + full_scale_mv[chan] - 1) /
+		       full_scale_mv[chan];
+
+	return (uint32_t)MIN(raw, BIT(resolution) - 1U);
+}
+
+static int replayValue(const struct device *dev, unsigned int chan, void *data,
+		       uint32_t *result)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(data);
+
+	if (CONFIG_APP_ADC_REPLAY_RATE_HZ > 0) {
+		int64_t elapsed_us = k_ticks_to_us_floor64(k_uptime_ticks() - start_ticks);
+		size_t target = (size_t)((elapsed_us * CONFIG_APP_ADC_REPLAY_RATE_HZ) / USEC_PER_SEC);
+
+		while (position < target) {
+			(void)adcReplayStep();
+			if (position == 0) {
+				break;
+			}
+		}
+	}
+
+	if (chan >= ARRAY_SIZE(current_row.mv)) {
+		return -EINVAL;
+	}
+
+	*result = millivoltsToRaw(chan, current_row.mv[chan]);
+	return 0;
+}
+
+static int adcReplayInit(void)
+{
+	const struct device *dev = DEVICE_DT_GET(ADC_REPLAY_NODE);
+	int err;
+
+	if (!device_is_ready(dev)) {
+		return -ENODEV;
+	}
+
+	adcReplayRewind();
+
+	for (unsigned int chan = 0; chan < ARRAY_SIZE(current_row.mv); chan++) {
+		full_scale_mv[chan] = replay_channels[chan].vref_mv;
+		err = adc_gain_invert(replay_channels[chan].channel_cfg.gain, &full_scale_mv[chan]);
+		if (err < 0 || full_scale_mv[chan] <= 0 ||
+		    full_scale_mv[chan] > (int32_t)BIT(replay_channels[chan].resolution)) {
+			printk("Channel %u steps are over 1 mV, replay cannot be exact\n", chan);
+			return -EINVAL;
+		}
+
+		err = adc_emul_raw_value_func_set(dev, chan, replayValue, NULL);
+		if (err < 0) {
+			printk("Could not attach replay to emulated channel %u (%d)\n", chan, err);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+SYS_INIT(adcReplayInit, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,24 @@
+#ifndef ADC_REPLAY_H_KJJ
+#define ADC_REPLAY_H_KJJ
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Replays a labeled capture in the output_data.txt format ("label x y z" per
+ * line, values in millivolts) through the ADC emulator on native_sim.
+ *
+ * With CONFIG_APP_ADC_REPLAY_RATE_HZ = 0 the current row only changes when
+ * adcReplayStep() is called, so every measurement is deterministic. Otherwise
+ * rows advance with simulated time at the configured rate.
+ */
+
+/* Label of the row the emulated ADC currently returns */
+int adcReplayLabel(void);
+/* Moves to the next row. Returns false and rewinds once the capture ends. */
+bool adcReplayStep(void);
+void adcReplayRewind(void);
+/* Rows consumed since the last rewind */
+size_t adcReplayPosition(void);
+
+
+#endif
@@ -0,0 +1,43 @@
+#include "adc.h"
+#include "classify.h"
+#include "kmeans.h"
+#include "kmeans_centers.h"
+#include "neural_network.h"
+
+/* Both classifiers feed the same confusion matrix from x, y, z */
+BUILD_ASSERT(KMEANS_DIMS == INPUT_DATA_SIZE, "classifiers disagree on input size");
+BUILD_ASSERT(KMEANS_CLASSES == LAYER_2_NEURONS, "classifiers disagree on class count");
+
+static inline int16_t clampInput(uint16_t value_mv)
+{
+	return value_mv > KMEANS_MAX_INPUT_MV ? KMEANS_MAX_INPUT_MV : (int16_t)value_mv;
+}
+
+void measurementsToSoa(const struct Measurement *m, size_t count,
+		       int16_t *x, int16_t *y, int16_t *z, struct measurement_soa *soa)
+{
+	for (size_t i = 0; i < count; i++) {
+		x[i] = clampInput(m[i].x);
+		y[i] = clampInput(m[i].y);
+		z[i] = clampInput(m[i].z);
+	}
+
+	soa->x = x;
+	soa->y = y;
+	soa->z = z;
+	soa->count = count;
+}
+
+void classifyBatch(const struct measurement_soa *in, uint8_t *labels)
+{
+#if defined(CONFIG_APP_CLASSIFIER_KMEANS) && defined(CONFIG_APP_KMEANS_ADAPT)
+	/* Every sample may move the centres, so they go through one by one */
+	for (size_t i = 0; i < in->count; i++) {
+		labels[i] = (uint8_t)kmeansClassifyAndAdapt(in->x[i], in->y[i], in->z[i]);
+	}
+#elif defined(CONFIG_APP_CLASSIFIER_KMEANS)
+	kmeansClassifyBatch(in, labels);
+#else
+	predictClassBatch(in, labels);
+#endif
+}
@@ -0,0 +1,42 @@
+#ifndef CLASSIFY_H_KJJ
+#define CLASSIFY_H_KJJ
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Measurement;
+
+/* Number of classes shared by both classifiers and the confusion matrix.
+ * Both model blobs must have this many outputs, which is checked at boot.
+ */
+#if defined(CONFIG_APP_CLASSES)
+#define CLASS_COUNT CONFIG_APP_CLASSES
+#else
+#define CLASS_COUNT 6
+#endif
+
+/* Structure-of-arrays view of a block of measurements, in millivolts. Values
+ * must lie within 0..KMEANS_MAX_INPUT_MV; measurementsToSoa() clamps them.
+ */
+struct measurement_soa
+{
+   const int16_t *x;
+   const int16_t *y;
+   const int16_t *z;
+   size_t count;
+};
+
+/* Splits count measurements into the x, y and z arrays and fills in soa */
+void measurementsToSoa(const struct Measurement *m, size_t count,
+		       int16_t *x, int16_t *y, int16_t *z, struct measurement_soa *soa);
+
+/* Classifies every measurement of the block with the classifier selected
+ * in Kconfig, writing one label per measurement.
+ */
+void classifyBatch(const struct measurement_soa *in, uint8_t *labels);
+
+void kmeansClassifyBatch(const struct measurement_soa *in, uint8_t *labels);
+void predictClassBatch(const struct measurement_soa *in, uint8_t *labels);
+
+
+#endif
@@ -0,0 +1,161 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/printk.h>
+#include "adc.h"
+#include "classify_worker.h"
+#include "confusion.h"
+#include "kmeans.h"
+#include "metrics.h"
+#include "models.h"
+#include "neural_network.h"
+
+LOG_MODULE_DECLARE(MAIN, CONFIG_APP_LOG_LEVEL);
+
+/* Measurement runs take seconds; they used to run in the button callback and
+ * held up the system workqueue for as long.
+ */
+K_MSGQ_DEFINE(classify_queue, sizeof(struct classify_cmd), CONFIG_APP_CLASSIFY_QUEUE_DEPTH,
+	      __alignof__(struct classify_cmd));
+
+int submitClassifyCommand(uint8_t type, int direction, uint16_t count)
+{
+	struct classify_cmd cmd = {
+		.type = type,
+		.direction = direction,
+		.count = count,
+	};
+	int err;
+
+	if (direction < -1 || direction >= METRICS_CLASSES) {
+		LOG_WRN("Direction %d out of range, command %u dropped", direction, type);
+		return -EINVAL;
+	}
+
+	err = k_msgq_put(&classify_queue, &cmd, K_NO_WAIT);
+	if (err) {
+		LOG_WRN("Classification busy, command %u dropped", type);
+		return -ENOMSG;
+	}
+	return 0;
+}
+
+#if defined(CONFIG_APP_CLASSIFIER_NN)
+/* printk has no float support here, so the margin (in logits) is printed in
+ * thousandths and the winner's softmax output in percent
+ */
+static void printConfidence(const struct Measurement *m)
+{
+	float probabilities[LAYER_2_NEURONS];
+	float margin;
+	int winner = predictClassWithConfidence(m->x, m->y, m->z, &margin, probabilities);
+	int margin_milli = (int)(margin * 1000 + 0.5f);
+
+	printk("class %d, margin %d.%03d, p = %d %%\n", winner + 1, margin_milli / 1000,
+	       margin_milli % 1000, (int)(probabilities[winner] * 100 + 0.5f));
+}
+#endif
+
+static void runCommand(const struct classify_cmd *cmd)
+{
+	switch (cmd->type) {
+	case CLASSIFY_CMD_MEASURE:
+		if (cmd->direction < 0 || cmd->direction >= METRICS_CLASSES) {
+			printk("No direction set, press button 3 first\n");
+			break;
+		}
+		for (int i = 0; i < cmd->count; i++) {
+			makeOneClassificationAndUpdateConfusionMatrix(cmd->direction);
+		}
+		printConfusionMatrix();
+		break;
+	case CLASSIFY_CMD_FAKE:
+		makeHundredFakeClassifications();
+		printConfusionMatrix();
+		break;
+	case CLASSIFY_CMD_SAMPLE: {
+		struct Measurement m = readADCValue();
+
+		printk("x = %d,  y = %d,  z = %d\n", m.x, m.y, m.z);
+#if defined(CONFIG_APP_CLASSIFIER_NN)
+		printConfidence(&m);
+#endif
+		break;
+	}
+	case CLASSIFY_CMD_PRINT:
+		printConfusionMatrix();
+		printClassMetrics();
+#if defined(CONFIG_APP_KMEANS_ADAPT)
+		printCentroidDrift();
+#endif
+		break;
+	case CLASSIFY_CMD_RESET:
+		resetConfusionMatrix();
+		printConfusionMatrix();
+		break;
+#if defined(CONFIG_APP_KMEANS_ADAPT)
+	case CLASSIFY_CMD_KMEANS_RESET:
+		kmeansResetToFactory();
+		printk("Centre points reset to the model's values\n");
+		break;
+#endif
+#if defined(CONFIG_APP_MODEL_SWAP_SHELL)
+	case CLASSIFY_CMD_MODEL_SWAP: {
+		int err = swapStagedModel();
+
+		if (err) {
+			printk("Model swap failed (err %d), previous model kept\n", err);
+		} else {
+			printk("Model swapped in\n");
+		}
+		break;
+	}
+	case CLASSIFY_CMD_MODEL_RESTORE:
+		if (restoreModels()) {
+			printk("Models in flash rejected\n");
+		} else {
+			printk("Models restored from flash\n");
+		}
+		break;
+#endif
+	default:
+		LOG_WRN("Unknown classification command %u", cmd->type);
+		break;
+	}
+}
+
+static void classifyThread(void)
+{
+	struct classify_cmd cmd;
+
+	for (;;) {
+		k_msgq_get(&classify_queue, &cmd, K_FOREVER);
+		runCommand(&cmd);
+	}
+}
+
+K_THREAD_DEFINE(classify_thread_id, CONFIG_APP_CLASSIFY_STACK_SIZE, classifyThread, NULL, NULL,
+		NULL, CONFIG_APP_CLASSIFY_PRIORITY, 0, 0);
+
+#if defined(CONFIG_APP_KMEANS_ADAPT_SHELL)
+
+/* Both go through the queue: the centres must not change under a run */
+static int cmdKmeansReset(const struct shell *sh, size_t argc, char **argv)
+{
+	return submitClassifyCommand(CLASSIFY_CMD_KMEANS_RESET, -1, 0);
+}
+
+static int cmdKmeansDrift(const struct shell *sh, size_t argc, char **argv)
+{
+	return submitClassifyCommand(CLASSIFY_CMD_PRINT, -1, 0);
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_kmeans,
+	SHELL_CMD(reset, NULL, "Discard the adapted centre points", cmdKmeansReset),
+	SHELL_CMD(drift, NULL, "Print the confusion matrix and the centre drift",
+		  cmdKmeansDrift),
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(kmeans, &sub_kmeans, "Adaptive k-means centre points", NULL);
+
+#endif
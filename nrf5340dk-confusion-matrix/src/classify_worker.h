@@ -0,0 +1,38 @@
+#ifndef CLASSIFY_WORKER_H_KJJ
+#define CLASSIFY_WORKER_H_KJJ
+
+#include <stdint.h>
+
+enum classify_cmd_type {
+	/* Measure and classify count blocks with direction as the true label */
+	CLASSIFY_CMD_MEASURE,
+	/* makeHundredFakeClassifications(), count and direction unused */
+	CLASSIFY_CMD_FAKE,
+	/* Read and print one measurement, with the network's class and
+	 * confidence when it is the classifier
+	 */
+	CLASSIFY_CMD_SAMPLE,
+	CLASSIFY_CMD_PRINT,
+	CLASSIFY_CMD_RESET,
+	/* Put the k-means centre points back to the model's values */
+	CLASSIFY_CMD_KMEANS_RESET,
+	/* Swap in the model received on the shell, or go back to flash */
+	CLASSIFY_CMD_MODEL_SWAP,
+	CLASSIFY_CMD_MODEL_RESTORE,
+};
+
+struct classify_cmd {
+	uint8_t type;
+	/* 0..METRICS_CLASSES - 1, or -1 when no direction is set */
+	int16_t direction;
+	uint16_t count;
+};
+
+/* Queues a command for the classification thread without blocking, so it is
+ * safe from the button handler and other work items. Commands run one at a
+ * time in order. Returns -EINVAL for a direction outside -1..METRICS_CLASSES - 1
+ * and -ENOMSG if the queue is full.
+ */
+int submitClassifyCommand(uint8_t type, int direction, uint16_t count);
+
+#endif
@@ -1,12 +1,21 @@
 #ifndef CONFUSION_MATRIX_H
 #define CONFUSION_MATRIX_H
 
+#include "adc.h"
 
 void printConfusionMatrix(void);
 void makeHundredFakeClassifications(void);
 void makeOneClassificationAndUpdateConfusionMatrix(int);
+int classifyAndUpdateConfusionMatrix(int, struct Measurement);
 int calculateDistanceToAllCentrePointsAndSelectWinner(int,int,int);
 void resetConfusionMatrix(void);
+/* Totals, accuracy and kappa; cheap enough to print after every batch */
+void printPerformanceMetrics(void);
+/* Per-class precision, recall and F1 with macro and micro averages */
+void printClassMetrics(void);
+#if defined(CONFIG_APP_KMEANS_ADAPT)
+void printCentroidDrift(void);
+#endif
 
 
 #endif
@@ -0,0 +1,92 @@
+#ifndef DENSE_KERNEL_H_KJJ
+#define DENSE_KERNEL_H_KJJ
+
+/*
+ * DENSE_KERNEL(name, weight_t, bias_t, acc_t, inputs, outputs) defines the
+ * tensor types name##_weights_t (weight_t[outputs][inputs]) and
+ * name##_biases_t (bias_t[outputs]) and a kernel computing out = w * in + b
+ * with acc_t accumulators. Both trip counts are compile-time constants and
+ * the loops are marked for full unrolling, so a layer compiles to
+ * straight-line multiply-adds.
+ *
+ * Run it with DENSE_RUN(name, &weights, &biases, in, out). The tensors are
+ * passed as pointers to whole arrays and matched against the kernel's
+ * tensor types with _Generic, so a tensor of any other shape or element type
+ * is a compile error rather than a pointer conversion.
+ *
+ * DENSE_TENSORS() defines the tensor types alone, for a hand-written
+ * name##_kernel with the same signature (e.g. a DSP version).
+ */
+#define DENSE_UNROLL _Pragma("GCC unroll 128")
+
+#define DENSE_TENSORS(name, weight_t, bias_t, inputs, outputs)                          \
+	_Static_assert((inputs) > 0 && (outputs) > 0, #name ": empty layer");          \
+	typedef weight_t name##_weights_t[(outputs)][(inputs)];                         \
+	typedef bias_t name##_biases_t[(outputs)]
+
+/* Passes p on as const type *, or fails to compile if it points to anything else */
+#define DENSE_TENSOR(type, p) _Generic((p), const type *: (p), type *: (const type *)(p))
+
+#define DENSE_KERNEL(name, weight_t, bias_t, acc_t, inputs, outputs)                   \
+	DENSE_TENSORS(name, weight_t, bias_t, inputs, outputs);                         \
+	static inline void name##_kernel(const name##_weights_t *w,                     \
+					 const name##_biases_t *b,                      \
+					 const acc_t in[(inputs)], acc_t out[(outputs)])\
+	{                                                                               \
+		DENSE_UNROLL                                                            \
+		for (int o = 0; o < (outputs); o++) {                                   \
+			acc_t acc = (*b)[o];                                            \
+			DENSE_UNROLL                                                    \
+			for (int i = 0; i < (inputs); i++) {                            \
+				acc += (acc_t)(*w)[o][i] * in[i];                       \
+			}                                                               \
+			out[o] = acc;                                                   \
+		}                                                                       \
+	}
+
+#define DENSE_RUN(name, w, b, in, out)                                                  \
+	name##_kernel(DENSE_TENSOR(name##_weights_t, w),                                \
+		      DENSE_TENSOR(name##_biases_t, b), (in), (out))
+
+/*
+ * DENSE_BATCH(name, acc_t, inputs, chunk) adds a batch form to a layer from
+ * DENSE_KERNEL or DENSE_TENSORS: name##_batch_row computes output o for n <=
+ * chunk samples held feature-major in a name##_batch_t (in[i][s]). The sample
+ * loop is innermost and branch free, so the compiler vectorizes it across
+ * samples. Callers keep one output row at a time, so their buffers grow with
+ * the chunk and the layer width but not with the class count.
+ *
+ * Run it with DENSE_RUN_BATCH(name, &weights, &biases, o, n, &in, out).
+ */
+#define DENSE_BATCH(name, acc_t, inputs, chunk)                                         \
+	typedef acc_t name##_batch_t[(inputs)][(chunk)];                                \
+	static inline void name##_batch_row(const name##_weights_t *w,                  \
+					    const name##_biases_t *b, int o, int n,     \
+					    const name##_batch_t *in, acc_t out[(chunk)])\
+	{                                                                               \
+		for (int s = 0; s < n; s++) {                                           \
+			out[s] = (*b)[o];                                               \
+		}                                                                       \
+		DENSE_UNROLL                                                            \
+		for (int i = 0; i < (inputs); i++) {                                    \
+			acc_t weight = (acc_t)(*w)[o][i];                               \
+                                                                                        \
+			for (int s = 0; s < n; s++) {                                   \
+				out[s] += weight * (*in)[i][s];                         \
+			}                                                               \
+		}                                                                       \
+	}
+
+#define DENSE_RUN_BATCH(name, w, b, o, n, in, out)                                      \
+	name##_batch_row(DENSE_TENSOR(name##_weights_t, w),                             \
+			 DENSE_TENSOR(name##_biases_t, b), (o), (n),                    \
+			 DENSE_TENSOR(name##_batch_t, in), (out))
+
+/* Checks at compile time that a layer consumes what the one before produces.
+ * Both sides must be stated separately for the check to mean anything.
+ */
+#define DENSE_CHAIN(prev_outputs, next_inputs)                                          \
+	_Static_assert((prev_outputs) == (next_inputs),                                 \
+		       "layer inputs do not match the previous layer's outputs")
+
+#endif
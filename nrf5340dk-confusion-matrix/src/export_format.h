@@ -0,0 +1,73 @@
+#ifndef EXPORT_FORMAT_H_KJJ
+#define EXPORT_FORMAT_H_KJJ
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary stream of classified samples, written by sample_export.c and read
+ * by neural-kmeans-c/sample_decode. It is a sequence of 16-byte
+ * little-endian frames that start with a sync byte and carry a CRC-8 over
+ * the frame with the crc8 field zeroed. A reader can attach at any point
+ * and skip bytes until a frame checks out, so text on the same UART only
+ * costs the frames it lands in.
+ *
+ * A header frame comes first and again every EXPORT_HEADER_INTERVAL
+ * samples. The sequence number counts sample frames, so gaps reveal frames
+ * dropped by the board or lost on the link. A sample that could not be
+ * classified has predicted EXPORT_UNCLASSIFIED.
+ */
+#define EXPORT_MAGIC 0x58454d43 /* "CMEX" */
+#define EXPORT_FORMAT_VERSION 1
+#define EXPORT_FRAME_SIZE 16
+#define EXPORT_HEADER_INTERVAL 1024
+#define EXPORT_UNCLASSIFIED 0xff
+
+enum export_sync {
+	EXPORT_SYNC_SAMPLE = 0xa5,
+	EXPORT_SYNC_HEADER = 0xa6,
+};
+
+struct export_header {
+	uint8_t sync;
+	uint8_t version;
+	uint8_t classes;
+	uint8_t crc8;
+	uint32_t magic;
+	/* Rate of the sample timestamps */
+	uint32_t timestamp_hz;
+	/* Sequence number of the next sample frame */
+	uint16_t seq;
+	uint16_t reserved;
+};
+
+struct export_sample {
+	uint8_t sync;
+	/* True direction */
+	uint8_t actual;
+	uint8_t predicted;
+	uint8_t crc8;
+	uint16_t seq;
+	/* Millivolts as classified, the columns of output_data.txt */
+	uint16_t x;
+	uint16_t y;
+	uint16_t z;
+	uint32_t timestamp;
+};
+
+/* CRC-8, polynomial 0x07, over a frame whose crc8 field is zero */
+static inline uint8_t exportCrc8(const void *frame)
+{
+	const uint8_t *p = frame;
+	uint8_t crc = 0;
+
+	for (size_t i = 0; i < EXPORT_FRAME_SIZE; i++) {
+		crc ^= p[i];
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x80) ? (uint8_t)(crc << 1) ^ 0x07 : (uint8_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+#endif
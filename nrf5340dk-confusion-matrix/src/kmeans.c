@@ -0,0 +1,280 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#if defined(__ARM_FEATURE_DSP) && defined(__ARM_FEATURE_SIMD32)
+#include <arm_acle.h>
+#endif
+#include "classify.h"
+#include "kmeans.h"
+#include "kmeans_centers.h"
+#include "model_format.h"
+
+/* Centre points in flash, inside the model blob */
+static const int16_t (*factory)[KMEANS_DIMS];
+
+#if defined(CONFIG_APP_KMEANS_ADAPT)
+
+/* Adapted centres carry ADAPT_FRAC_BITS extra fractional bits so that small
+ * steps of (sample - centre) / 2^shift are not lost to rounding.
+ */
+#define ADAPT_FRAC_BITS 8
+#define ADAPT_MIN_MARGIN \
+	((uint32_t)CONFIG_APP_KMEANS_ADAPT_MIN_MARGIN_MV2 << (2 * KMEANS_CENTER_SHIFT))
+#define ADAPT_MAX_DRIFT \
+	((int32_t)CONFIG_APP_KMEANS_ADAPT_MAX_DRIFT_MV << (KMEANS_CENTER_SHIFT + ADAPT_FRAC_BITS))
+
+static int16_t adapted_centers_q[KMEANS_CLASSES][KMEANS_DIMS];
+static int32_t adapted_acc[KMEANS_CLASSES][KMEANS_DIMS];
+static int32_t max_offset[KMEANS_CLASSES];
+static uint32_t updates[KMEANS_CLASSES];
+static bool adapted;
+
+#endif
+
+/* Centre k in use: the factory value until the first update, the adapted copy
+ * after that
+ */
+static inline const int16_t *centre(int k)
+{
+#if defined(CONFIG_APP_KMEANS_ADAPT)
+	if (adapted) {
+		return adapted_centers_q[k];
+	}
+#endif
+	return factory[k];
+}
+
+int kmeansLoadModel(const struct model_header *hdr)
+{
+	if (hdr->inputs != KMEANS_DIMS || hdr->outputs != KMEANS_CLASSES ||
+	    hdr->frac_bits != KMEANS_CENTER_SHIFT) {
+		return -EINVAL;
+	}
+
+	factory = modelPayload(hdr);
+#if defined(CONFIG_APP_KMEANS_ADAPT)
+	kmeansResetToFactory();
+#endif
+	return 0;
+}
+
+static inline int32_t toCentreScale(int32_t value_mv)
+{
+	if (value_mv < 0) {
+		value_mv = 0;
+	} else if (value_mv > KMEANS_MAX_INPUT_MV) {
+		value_mv = KMEANS_MAX_INPUT_MV;
+	}
+	return value_mv << KMEANS_CENTER_SHIFT;
+}
+
+/* Squared euclidean distances only: sqrt is monotonic so it does not change
+ * which centre is nearest. With inputs clamped to KMEANS_MAX_INPUT_MV each
+ * term is below 2^30 and the sum of three below 2^32.
+ */
+int kmeansNearestCentroid(int32_t x, int32_t y, int32_t z, uint32_t *margin)
+{
+	int32_t px = toCentreScale(x);
+	int32_t py = toCentreScale(y);
+	int32_t pz = toCentreScale(z);
+	uint32_t best = UINT32_MAX;
+	uint32_t second = UINT32_MAX;
+	int winner = 0;
+
+	for (int k = 0; k < KMEANS_CLASSES; k++) {
+		const int16_t *c = centre(k);
+		int32_t dx = px - c[0];
+		int32_t dy = py - c[1];
+		int32_t dz = pz - c[2];
+		uint32_t d = (uint32_t)(dx * dx) + (uint32_t)(dy * dy) + (uint32_t)(dz * dz);
+
+		if (d < best) {
+			second = best;
+			best = d;
+			winner = k;
+		} else if (d < second) {
+			second = d;
+		}
+	}
+
+	if (margin != NULL) {
+		*margin = second - best;
+	}
+	return winner;
+}
+
+#if defined(__ARM_FEATURE_DSP) && defined(__ARM_FEATURE_SIMD32)
+
+/* Cortex-M33 DSP extension: x and y are handled as one packed pair of 16-bit
+ * lanes. SSUB16 forms both differences at once, SMUAD squares and adds them
+ * and SMLABB adds the z term, so each centre costs a few single-cycle
+ * instructions. Inputs are at most 8191 mV (32764 in centre scale), which
+ * keeps every difference inside int16 and dx^2 + dy^2 below 2^31.
+ */
+void kmeansClassifyBatch(const struct measurement_soa *in, uint8_t *labels)
+{
+	uint32_t centre_xy[KMEANS_CLASSES];
+	int32_t centre_z[KMEANS_CLASSES];
+
+	for (int k = 0; k < KMEANS_CLASSES; k++) {
+		const int16_t *c = centre(k);
+
+		centre_xy[k] = ((uint32_t)(uint16_t)c[1] << 16) | (uint16_t)c[0];
+		centre_z[k] = c[2];
+	}
+
+	for (size_t i = 0; i < in->count; i++) {
+		uint32_t p_xy = ((uint32_t)(uint16_t)(in->y[i] << KMEANS_CENTER_SHIFT) << 16) |
+				(uint16_t)(in->x[i] << KMEANS_CENTER_SHIFT);
+		int32_t p_z = in->z[i] << KMEANS_CENTER_SHIFT;
+		uint32_t best = UINT32_MAX;
+		uint8_t winner = 0;
+
+		for (int k = 0; k < KMEANS_CLASSES; k++) {
+			int16x2_t d_xy = __ssub16((int16x2_t)p_xy, (int16x2_t)centre_xy[k]);
+			int32_t dz = p_z - centre_z[k];
+			uint32_t d = (uint32_t)__smlabb(dz, dz, __smuad(d_xy, d_xy));
+
+			if (d < best) {
+				best = d;
+				winner = (uint8_t)k;
+			}
+		}
+		labels[i] = winner;
+	}
+}
+
+#else
+
+#define KMEANS_BATCH_CHUNK 64
+
+/* Portable version: the sample loop is innermost and branch free so the
+ * compiler can vectorize it over a chunk of samples for each centre.
+ */
+void kmeansClassifyBatch(const struct measurement_soa *in, uint8_t *labels)
+{
+	for (size_t base = 0; base < in->count; base += KMEANS_BATCH_CHUNK) {
+		size_t n = in->count - base;
+		uint32_t best[KMEANS_BATCH_CHUNK];
+		uint8_t winner[KMEANS_BATCH_CHUNK];
+		const int16_t *x = in->x + base;
+		const int16_t *y = in->y + base;
+		const int16_t *z = in->z + base;
+
+		if (n > KMEANS_BATCH_CHUNK) {
+			n = KMEANS_BATCH_CHUNK;
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			best[i] = UINT32_MAX;
+			winner[i] = 0;
+		}
+
+		for (int k = 0; k < KMEANS_CLASSES; k++) {
+			const int16_t *c = centre(k);
+			int32_t cx = c[0];
+			int32_t cy = c[1];
+			int32_t cz = c[2];
+
+			for (size_t i = 0; i < n; i++) {
+				int32_t dx = (x[i] << KMEANS_CENTER_SHIFT) - cx;
+				int32_t dy = (y[i] << KMEANS_CENTER_SHIFT) - cy;
+				int32_t dz = (z[i] << KMEANS_CENTER_SHIFT) - cz;
+				uint32_t d = (uint32_t)(dx * dx) + (uint32_t)(dy * dy) +
+					     (uint32_t)(dz * dz);
+				int closer = d < best[i];
+
+				best[i] = closer ? d : best[i];
+				winner[i] = closer ? (uint8_t)k : winner[i];
+			}
+		}
+
+		memcpy(labels + base, winner, n);
+	}
+}
+
+#endif
+
+#if defined(CONFIG_APP_KMEANS_ADAPT)
+
+void kmeansResetToFactory(void)
+{
+	for (int k = 0; k < KMEANS_CLASSES; k++) {
+		for (int d = 0; d < KMEANS_DIMS; d++) {
+			adapted_centers_q[k][d] = factory[k][d];
+			adapted_acc[k][d] = (int32_t)factory[k][d] << ADAPT_FRAC_BITS;
+		}
+		max_offset[k] = 0;
+		updates[k] = 0;
+	}
+	adapted = false;
+}
+
+/* Exponential update of the winning centre towards the sample:
+ * c += (p - c) / 2^CONFIG_APP_KMEANS_ADAPT_SHIFT, only for samples whose
+ * margin shows they are not near a decision boundary, and never further than
+ * CONFIG_APP_KMEANS_ADAPT_MAX_DRIFT_MV from the factory centre.
+ */
+static void adaptCentre(const int32_t p[KMEANS_DIMS], int k, uint32_t margin)
+{
+	if (margin < ADAPT_MIN_MARGIN) {
+		return;
+	}
+
+	if (!adapted) {
+		kmeansResetToFactory();
+		adapted = true;
+	}
+
+	for (int d = 0; d < KMEANS_DIMS; d++) {
+		int32_t home = (int32_t)factory[k][d] << ADAPT_FRAC_BITS;
+		int32_t acc = adapted_acc[k][d];
+		int32_t offset;
+
+		acc += ((p[d] << ADAPT_FRAC_BITS) - acc) >> CONFIG_APP_KMEANS_ADAPT_SHIFT;
+		if (acc > home + ADAPT_MAX_DRIFT) {
+			acc = home + ADAPT_MAX_DRIFT;
+		} else if (acc < home - ADAPT_MAX_DRIFT) {
+			acc = home - ADAPT_MAX_DRIFT;
+		}
+
+		adapted_acc[k][d] = acc;
+		adapted_centers_q[k][d] = (int16_t)((acc + (1 << (ADAPT_FRAC_BITS - 1))) >> ADAPT_FRAC_BITS);
+
+		offset = adapted_centers_q[k][d] - factory[k][d];
+		if (offset < 0) {
+			offset = -offset;
+		}
+		if (offset > max_offset[k]) {
+			max_offset[k] = offset;
+		}
+	}
+	updates[k]++;
+}
+
+int kmeansClassifyAndAdapt(int32_t x, int32_t y, int32_t z)
+{
+	int32_t p[KMEANS_DIMS] = {toCentreScale(x), toCentreScale(y), toCentreScale(z)};
+	uint32_t margin;
+	int winner = kmeansNearestCentroid(x, y, z, &margin);
+
+	adaptCentre(p, winner, margin);
+	return winner;
+}
+
+int kmeansGetDrift(int k, struct kmeans_drift *drift)
+{
+	if (k < 0 || k >= KMEANS_CLASSES) {
+		return -EINVAL;
+	}
+
+	for (int d = 0; d < KMEANS_DIMS; d++) {
+		drift->offset[d] = centre(k)[d] - factory[k][d];
+	}
+	drift->max_offset = max_offset[k];
+	drift->updates = updates[k];
+	return 0;
+}
+
+#endif
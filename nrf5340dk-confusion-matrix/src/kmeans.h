@@ -0,0 +1,49 @@
+#ifndef KMEANS_H_KJJ
+#define KMEANS_H_KJJ
+
+#include <stdint.h>
+
+/* Largest input accepted by the classifier; larger values are clamped so the
+ * squared distances always fit in 32 bits.
+ */
+#define KMEANS_MAX_INPUT_MV 8191
+
+struct model_header;
+
+/* Takes the centre points from a checked MODEL_TYPE_KMEANS blob, which must
+ * stay valid afterwards. Returns -EINVAL if its shape or fixed-point scale
+ * differs from kmeans_centers.h.
+ */
+int kmeansLoadModel(const struct model_header *hdr);
+
+/* Returns the index of the centre point closest to (x, y, z), given in
+ * millivolts. If margin is not NULL it receives the squared distance to the
+ * runner-up minus the squared distance to the winner, in
+ * (mV * 2^KMEANS_CENTER_SHIFT)^2 units. A small margin means the sample lies
+ * close to a decision boundary.
+ */
+int kmeansNearestCentroid(int32_t x, int32_t y, int32_t z, uint32_t *margin);
+
+#if defined(CONFIG_APP_KMEANS_ADAPT)
+/* Drift of one adapted centre from its factory value, in
+ * mV * 2^KMEANS_CENTER_SHIFT.
+ */
+struct kmeans_drift
+{
+   int32_t offset[3];
+   /* Largest |offset| on any axis since the last reset */
+   int32_t max_offset;
+   /* Samples that have moved this centre */
+   uint32_t updates;
+};
+
+/* Classifies like kmeansNearestCentroid() and, when the margin to the
+ * runner-up is large enough, moves the winning centre towards the sample.
+ */
+int kmeansClassifyAndAdapt(int32_t x, int32_t y, int32_t z);
+void kmeansResetToFactory(void);
+int kmeansGetDrift(int k, struct kmeans_drift *drift);
+#endif
+
+
+#endif
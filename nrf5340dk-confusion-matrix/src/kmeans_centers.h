@@ -1,10 +1,16 @@
-float centers[6][3] = {
-    {1320.444444, 1630.296296, 1629.148148},
-    {1969.857143, 1602.607143, 1620.428571},
-    {1623.035714, 1282.500000, 1609.678571},
-    {1664.851852, 1948.481481, 1642.592593},
-    {1640.785714, 1633.642857, 1312.321429},
-    {1644.892857, 1620.178571, 1956.250000}
-};
-
-//1. pienin X, isoin X, pienin Y, isoin Y, pienin Z, isoin Z
+#ifndef KMEANS_CENTERS_H
+#define KMEANS_CENTERS_H
+
+#include <stdint.h>
+#include "classify.h"
+
+#define KMEANS_CLASSES CLASS_COUNT
+#define KMEANS_DIMS 3
+
+/* Fixed-point scale of the centre points: value = mV * 2^KMEANS_CENTER_SHIFT */
+#define KMEANS_CENTER_SHIFT 2
+
+// The centre points themselves come from models/kmeans.bin (see
+// model_format.h); a model with another shape or scale is rejected at boot.
+
+#endif
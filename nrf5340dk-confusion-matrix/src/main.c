@@ -11,11 +11,25 @@
 #include <zephyr/kernel.h>
 #include <zephyr/sys/printk.h>
 #include <zephyr/sys/util.h>
+#include <zephyr/timing/timing.h>
 #include "adc.h"
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 
+#include "classify_worker.h"
 #include "confusion.h"
+#include "metrics.h"
+#include "models.h"
+#include "neural_network.h"
+#if defined(CONFIG_APP_NN_BENCH)
+#include "nn_bench.h"
+#endif
+#if defined(CONFIG_APP_SAMPLE_EXPORT)
+#include "sample_export.h"
+#endif
+#if defined(CONFIG_APP_ADC_REPLAY)
+#include "adc_replay.h"
+#endif
 
 
 
@@ -39,8 +53,42 @@ static int direction = -1;	// 0 = x direction high
 							// 5 = z direction low
                 				 
 
-LOG_MODULE_REGISTER(MAIN, LOG_LEVEL_INF);
+/* Classes beyond the six orientations are only numbered */
+static const char *const direction_names[] = {
+	"x = high", "x = low", "y = high", "y = low", "z = high", "z = low",
+};
 
+LOG_MODULE_REGISTER(MAIN, CONFIG_APP_LOG_LEVEL);
+
+#if defined(CONFIG_APP_ADC_REPLAY) && (CONFIG_APP_ADC_REPLAY_RATE_HZ == 0)
+/* Runs every row of the replayed capture through the classifier, using the
+ * recorded label as the true direction.
+ */
+static void runReplay(void)
+{
+	int64_t start = k_uptime_get();
+	size_t rows = 0;
+
+	resetConfusionMatrix();
+	do {
+		int label = adcReplayLabel();
+		struct Measurement m = readADCValue();
+
+		if (label >= 0 && label < METRICS_CLASSES) {
+			classifyAndUpdateConfusionMatrix(label, m);
+			rows++;
+		}
+	} while (adcReplayStep());
+
+	printk("Replayed %d rows in %d ms of simulated time\n",
+	       (int)rows, (int)(k_uptime_get() - start));
+	printConfusionMatrix();
+}
+#endif
+
+/* Runs in the dk_buttons work item, so it only queues the slow parts for
+ * the classification thread.
+ */
 static void button_changed(uint32_t button_state, uint32_t has_changed)
 {
 	//printk("button_state = %d\n",button_state);
@@ -48,14 +96,13 @@ static void button_changed(uint32_t button_state, uint32_t has_changed)
 	if ((has_changed & USER_BUTTON_1) && (button_state & USER_BUTTON_1)) 
 	{
 		printk("Button 1 down, printing current Confusion Matrix\n");
-		printConfusionMatrix();
+		submitClassifyCommand(CLASSIFY_CMD_PRINT, direction, 0);
 	}
 
 	if ((has_changed & USER_BUTTON_2) && (button_state & USER_BUTTON_2)) 
 	{
 		printk("Button 2 down, resetting confusion matrix\n");
-		resetConfusionMatrix();
-		printConfusionMatrix();
+		submitClassifyCommand(CLASSIFY_CMD_RESET, direction, 0);
 	}		
 	
 	if ((has_changed & USER_BUTTON_3) && (button_state & USER_BUTTON_3)) 
@@ -63,46 +110,26 @@ static void button_changed(uint32_t button_state, uint32_t has_changed)
 		printk("Button 3 down, making fake 100 meas or one real meas depending on DEBUG state\n");
 		#if DEBUG
 		direction = 0;
-		makeHundredFakeClassifications();
-		printConfusionMatrix();
+		submitClassifyCommand(CLASSIFY_CMD_FAKE, direction, 0);
 		#else
-        direction = (direction +1)%6;
-		switch (direction)
+        direction = (direction + 1) % METRICS_CLASSES;
+		if ((size_t)direction < ARRAY_SIZE(direction_names))
 		{
-		case 0:
-			printk("Direction is now set x = high\n");
-			break;
-		case 1:
-			printk("Direction is now set x = low\n");
-			break;
-		case 2:
-			printk("Direction is now set y = high\n");
-			break;
-		case 3:
-			printk("Direction is now set y = low\n");
-			break;
-		case 4:
-			printk("Direction is now set z = high\n");
-			break;
-		case 5:
-			printk("Direction is now set z = low\n");
-			break;
-		
-		default:
-		    printk("Wrong direction set!!!\n");
-			break;
+			printk("Direction is now set %s\n", direction_names[direction]);
+		}
+		else
+		{
+			printk("Direction is now set to class %d\n", direction + 1);
 		}
 
-		struct Measurement m = readADCValue();
-		printk("x = %d,  y = %d,  z = %d\n",m.x,m.y,m.z);
+		submitClassifyCommand(CLASSIFY_CMD_SAMPLE, direction, 0);
 		#endif
 	}		
 
 	if ((has_changed & USER_BUTTON_4) && (button_state & USER_BUTTON_4)) 
 	{
 		printk("button 4 down, one meas and classification with current direction =%d\n",direction);
-		makeOneClassificationAndUpdateConfusionMatrix(direction);
-		printConfusionMatrix();
+		submitClassifyCommand(CLASSIFY_CMD_MEASURE, direction, 1);
 	}		
 }
 
@@ -116,6 +143,27 @@ void main(void)
 		return;
 	}
 
+#if defined(CONFIG_APP_NN_BENCH)
+	nnBenchRun();
+#endif
+
+	err = loadModels();
+	if (err) {
+		return;
+	}
+
+#if defined(CONFIG_APP_SAMPLE_EXPORT)
+	err = sampleExportInit();
+	if (err) {
+		return;
+	}
+#endif
+
+#if defined(CONFIG_TIMING_FUNCTIONS)
+	timing_init();
+	timing_start();
+#endif
+
 	err = dk_buttons_init(button_changed);
 	if (err) {
 		printk("Cannot init buttons (err: %d)\n", err);
@@ -129,6 +177,18 @@ void main(void)
 	return;
 	}
 
+#if defined(CONFIG_APP_ADC_REPLAY) && (CONFIG_APP_ADC_REPLAY_RATE_HZ == 0)
+	runReplay();
+#endif
+
+#if defined(CONFIG_APP_ADC_STREAM)
+	err = startADCStream(CONFIG_APP_ADC_STREAM_INTERVAL_US);
+	if (err) {
+		LOG_ERR("ADC stream failed to start (err %d)\n", err);
+		return;
+	}
+#endif
+
 	while (1) 
 	{
 		// struct Measurement m = readADCValue();
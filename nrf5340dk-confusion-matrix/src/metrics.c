@@ -0,0 +1,136 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include "metrics.h"
+
+static struct {
+	confusion_count_t counts[METRICS_CLASSES][METRICS_CLASSES];
+	uint32_t row[METRICS_CLASSES];
+	uint32_t col[METRICS_CLASSES];
+	uint32_t diag[METRICS_CLASSES];
+	uint32_t total;
+	uint32_t correct;
+	/* sum of row[i] * col[i], the numerator of the chance agreement */
+	uint64_t chance;
+} m;
+
+static struct k_spinlock lock;
+
+static inline void record(int actual, int predicted)
+{
+	/* (r + 1)(c + 1) - rc for the pair that grows on both sides, else just
+	 * the opposite total of each side that grows
+	 */
+	m.chance += m.col[actual] + m.row[predicted] + (actual == predicted);
+	if (m.counts[actual][predicted] < CONFUSION_COUNT_MAX) {
+		m.counts[actual][predicted]++;
+	}
+	m.row[actual]++;
+	m.col[predicted]++;
+	m.total++;
+	if (actual == predicted) {
+		m.diag[actual]++;
+		m.correct++;
+	}
+}
+
+void metricsRecord(int actual, int predicted)
+{
+	if (actual < 0 || actual >= METRICS_CLASSES || predicted < 0 ||
+	    predicted >= METRICS_CLASSES) {
+		return;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	record(actual, predicted);
+	k_spin_unlock(&lock, key);
+}
+
+void metricsRecordBatch(int actual, const uint8_t *predicted, size_t count)
+{
+	if (actual < 0 || actual >= METRICS_CLASSES) {
+		return;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	for (size_t i = 0; i < count; i++) {
+		if (predicted[i] < METRICS_CLASSES) {
+			record(actual, predicted[i]);
+		}
+	}
+	k_spin_unlock(&lock, key);
+}
+
+void metricsReset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	memset(&m, 0, sizeof(m));
+	k_spin_unlock(&lock, key);
+}
+
+uint32_t metricsCount(int actual, int predicted)
+{
+	return m.counts[actual][predicted];
+}
+
+/* num / den in basis points, 0 when undefined */
+static uint16_t ratio(uint64_t num, uint64_t den)
+{
+	return den ? (uint16_t)(num * METRICS_ONE / den) : 0;
+}
+
+void metricsSummary(struct metrics_summary *out)
+{
+	uint32_t precision = 0, recall = 0, f1 = 0;
+	uint64_t chance, total;
+
+	/* Snapshot straight into out, so the stack use does not grow with the
+	 * class count
+	 */
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	for (int i = 0; i < METRICS_CLASSES; i++) {
+		out->classes[i].support = m.row[i];
+		out->classes[i].predicted = m.col[i];
+		out->classes[i].correct = m.diag[i];
+	}
+	out->total = m.total;
+	out->correct = m.correct;
+	chance = m.chance;
+	k_spin_unlock(&lock, key);
+
+	for (int i = 0; i < METRICS_CLASSES; i++) {
+		struct class_metrics *c = &out->classes[i];
+
+		c->precision = ratio(c->correct, c->predicted);
+		c->recall = ratio(c->correct, c->support);
+		c->f1 = ratio(2ULL * c->correct, (uint64_t)c->support + c->predicted);
+		precision += c->precision;
+		recall += c->recall;
+		f1 += c->f1;
+	}
+
+	out->accuracy = ratio(out->correct, out->total);
+	out->macro_precision = precision / METRICS_CLASSES;
+	out->macro_recall = recall / METRICS_CLASSES;
+	out->macro_f1 = f1 / METRICS_CLASSES;
+
+	/* kappa = (p_o - p_e) / (1 - p_e) = (N * correct - chance) / (N^2 - chance),
+	 * scaled down until the basis point product cannot overflow
+	 */
+	total = out->total;
+	uint64_t agree = total * out->correct;
+	uint64_t den = total * total - chance;
+	bool negative = agree < chance;
+	uint64_t num = negative ? chance - agree : agree - chance;
+
+	while (den >= (1ULL << 48) || num >= (1ULL << 48)) {
+		den >>= 1;
+		num >>= 1;
+	}
+	num = den ? MIN(num * METRICS_ONE / den, INT16_MAX) : 0;
+	out->kappa = negative ? -(int16_t)num : (int16_t)num;
+}
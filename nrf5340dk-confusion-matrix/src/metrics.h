@@ -0,0 +1,56 @@
+#ifndef METRICS_H_KJJ
+#define METRICS_H_KJJ
+
+#include <stddef.h>
+#include <stdint.h>
+#include "classify.h"
+
+/* Confusion matrix with running row, column and diagonal totals, so that
+ * recording a classification is O(1) and a report is O(classes) without
+ * rescanning the matrix. Rates are integers in basis points (1/100 %).
+ */
+#define METRICS_CLASSES CLASS_COUNT
+#define METRICS_ONE 10000
+
+/* Matrix cells saturate at their maximum; the totals are always exact */
+#if defined(CONFIG_APP_CONFUSION_COUNTER_16)
+typedef uint16_t confusion_count_t;
+#define CONFUSION_COUNT_MAX UINT16_MAX
+#else
+typedef uint32_t confusion_count_t;
+#define CONFUSION_COUNT_MAX UINT32_MAX
+#endif
+
+struct class_metrics {
+	uint32_t support;   /* samples whose true class this is */
+	uint32_t predicted; /* samples classified as this class */
+	uint32_t correct;
+	uint16_t precision;
+	uint16_t recall;
+	uint16_t f1;
+};
+
+struct metrics_summary {
+	uint32_t total;
+	uint32_t correct;
+	/* Also micro-averaged precision, recall and F1 for one label per sample */
+	uint16_t accuracy;
+	uint16_t macro_precision;
+	uint16_t macro_recall;
+	uint16_t macro_f1;
+	/* Cohen's kappa, -METRICS_ONE..METRICS_ONE */
+	int16_t kappa;
+	struct class_metrics classes[METRICS_CLASSES];
+};
+
+void metricsRecord(int actual, int predicted);
+void metricsRecordBatch(int actual, const uint8_t *predicted, size_t count);
+void metricsReset(void);
+uint32_t metricsCount(int actual, int predicted);
+
+/* Consistent snapshot, safe while another thread keeps recording. The
+ * summary grows with METRICS_CLASSES; keep it off small thread stacks.
+ */
+void metricsSummary(struct metrics_summary *out);
+
+#endif
@@ -0,0 +1,68 @@
+#include <errno.h>
+#include "model_format.h"
+
+/* Plain C with no Zephyr dependencies: the host tools build this same file,
+ * so the firmware and the host always accept exactly the same blobs.
+ */
+
+uint32_t modelCrc32(const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	uint32_t crc = 0xffffffff;
+
+	while (size--) {
+		crc ^= *p++;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+		}
+	}
+	return ~crc;
+}
+
+size_t modelPayloadSize(const struct model_header *hdr)
+{
+	size_t inputs = hdr->inputs;
+	size_t hidden = hdr->hidden;
+	size_t outputs = hdr->outputs;
+
+	if (hdr->type == MODEL_TYPE_KMEANS && hdr->quant == MODEL_QUANT_FIXED16) {
+		return outputs * inputs * sizeof(int16_t);
+	}
+	if (hdr->type == MODEL_TYPE_DENSE && hdr->quant == MODEL_QUANT_FLOAT32 && hidden > 0) {
+		return (hidden * inputs + hidden + outputs * hidden + outputs) * sizeof(float);
+	}
+	if (hdr->type == MODEL_TYPE_DENSE && hdr->quant == MODEL_QUANT_INT8 && hidden > 0 &&
+	    hdr->frac_bits < 63) {
+		return sizeof(float) + (2 * hidden + outputs) * sizeof(int32_t) +
+		       (hidden * inputs + outputs * hidden) * sizeof(int8_t);
+	}
+	return 0;
+}
+
+int modelCheck(const void *blob, size_t size, uint8_t type, const struct model_header **hdr)
+{
+	const struct model_header *h = blob;
+	size_t expected;
+
+	if (size < sizeof(*h) || h->magic != MODEL_MAGIC) {
+		return -EINVAL;
+	}
+	if (h->version != MODEL_FORMAT_VERSION || h->type != type) {
+		return -ENOTSUP;
+	}
+
+	expected = modelPayloadSize(h);
+	if (expected == 0) {
+		return -ENOTSUP;
+	}
+	if (h->inputs == 0 || h->outputs == 0 || h->payload_size != expected ||
+	    size - sizeof(*h) < expected) {
+		return -EINVAL;
+	}
+	if (modelCrc32(modelPayload(h), expected) != h->crc32) {
+		return -EBADMSG;
+	}
+
+	*hdr = h;
+	return 0;
+}
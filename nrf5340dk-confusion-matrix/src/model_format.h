@@ -0,0 +1,88 @@
+#ifndef MODEL_FORMAT_H_KJJ
+#define MODEL_FORMAT_H_KJJ
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary model blob shared by the firmware and the host tools in
+ * neural-kmeans-c. All fields are little-endian. The header is followed
+ * directly by payload_size bytes of tensors; the header size keeps the
+ * payload 4-byte aligned so it can be used in place from flash.
+ *
+ * MODEL_TYPE_KMEANS, MODEL_QUANT_FIXED16:
+ *   int16_t centres[outputs][inputs], value = mV * 2^frac_bits
+ *
+ * MODEL_TYPE_DENSE, MODEL_QUANT_FLOAT32:
+ *   float w0[hidden][inputs], b0[hidden]     (ReLU)
+ *   float w1[outputs][hidden], b1[outputs]   (softmax)
+ *
+ * MODEL_TYPE_DENSE, MODEL_QUANT_INT8 (32-bit fields first for alignment):
+ *   float   output_scale     real value of one layer 1 accumulator step
+ *   int32_t b0[hidden]       layer 0 bias in units of its weight scale x 1 mV
+ *   int32_t m0[hidden]       requantization multipliers, Q(frac_bits): weight
+ *                            scale / activation scale, per hidden neuron
+ *   int32_t b1[outputs]      layer 1 bias in units of output_scale
+ *   int8_t  w0[hidden][inputs]   per-neuron symmetric scale
+ *   int8_t  w1[outputs][hidden]  one symmetric scale for the layer, after
+ *                                scaling each column by its neuron's
+ *                                activation scale
+ *   Inputs are whole millivolts; the ReLU output of neuron j is
+ *   clamp((acc * m0[j]) >> frac_bits, 0, 127) and the class is the argmax
+ *   of the layer 1 accumulators.
+ */
+#define MODEL_MAGIC 0x4c444d43 /* "CMDL" */
+/* 2: MODEL_QUANT_INT8 gained output_scale and per-neuron m0 */
+#define MODEL_FORMAT_VERSION 2
+
+enum model_type {
+	MODEL_TYPE_KMEANS = 1,
+	MODEL_TYPE_DENSE = 2,
+};
+
+enum model_quant {
+	MODEL_QUANT_FIXED16 = 1,
+	MODEL_QUANT_FLOAT32 = 2,
+	MODEL_QUANT_INT8 = 3,
+};
+
+struct model_header {
+	uint32_t magic;
+	uint16_t version;
+	uint8_t type;
+	uint8_t quant;
+	uint16_t inputs;
+	/* Hidden layer width for dense models, 0 for k-means */
+	uint16_t hidden;
+	/* Number of classes */
+	uint16_t outputs;
+	/* Fixed-point shift of MODEL_QUANT_FIXED16 tensors or of the
+	 * MODEL_QUANT_INT8 requantization multipliers
+	 */
+	uint8_t frac_bits;
+	uint8_t reserved;
+	uint32_t payload_size;
+	/* CRC-32 (IEEE) of the payload */
+	uint32_t crc32;
+};
+
+static inline const void *modelPayload(const struct model_header *hdr)
+{
+	return hdr + 1;
+}
+
+uint32_t modelCrc32(const void *data, size_t size);
+
+/* Size in bytes the payload of a model with this header must have, or 0 if
+ * the type and quantization do not go together.
+ */
+size_t modelPayloadSize(const struct model_header *hdr);
+
+/* Checks that blob holds a complete, intact model of the given type.
+ * Returns 0 and sets *hdr on success, -EINVAL for a truncated or malformed
+ * blob, -ENOTSUP for an unknown version, type or quantization and -EBADMSG
+ * when the CRC does not match.
+ */
+int modelCheck(const void *blob, size_t size, uint8_t type, const struct model_header **hdr);
+
+#endif
@@ -0,0 +1,217 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/util.h>
+#include "classify_worker.h"
+#include "kmeans.h"
+#include "model_format.h"
+#include "models.h"
+#include "neural_network.h"
+
+LOG_MODULE_DECLARE(MAIN, CONFIG_APP_LOG_LEVEL);
+
+/* The blobs stay in flash; the classifiers read their tensors in place */
+static const uint8_t kmeans_blob[] __aligned(4) = {
+#include "model_kmeans.inc"
+};
+
+static const uint8_t dense_blob[] __aligned(4) = {
+#if defined(CONFIG_APP_NN_INT8)
+#include "model_dense_int8.inc"
+#else
+#include "model_dense.inc"
+#endif
+};
+
+static int loadModel(const char *name, const uint8_t *blob, size_t size, uint8_t type,
+		     int (*load)(const struct model_header *hdr))
+{
+	const struct model_header *hdr;
+	int err = modelCheck(blob, size, type, &hdr);
+
+	if (err) {
+		LOG_ERR("%s model rejected (err %d)", name, err);
+		return err;
+	}
+
+	err = load(hdr);
+	if (err) {
+		LOG_ERR("%s model does not fit this build (err %d)", name, err);
+		return err;
+	}
+
+	LOG_INF("%s model v%d, %d bytes, crc32 %08x", name, hdr->version,
+		(int)(sizeof(*hdr) + hdr->payload_size), hdr->crc32);
+	return 0;
+}
+
+int loadModels(void)
+{
+	int err;
+
+	err = loadModel("k-means", kmeans_blob, sizeof(kmeans_blob), MODEL_TYPE_KMEANS,
+			kmeansLoadModel);
+	if (err) {
+		return err;
+	}
+
+	return loadModel("Neural network", dense_blob, sizeof(dense_blob), MODEL_TYPE_DENSE,
+			 initializeNeuralNetwork);
+}
+
+#if defined(CONFIG_APP_MODEL_SWAP)
+
+/* The only RAM copies of a model, made when one is swapped in at runtime */
+static uint8_t swap_slot[2][CONFIG_APP_MODEL_SWAP_MAX_SIZE] __aligned(4);
+
+int swapModel(uint8_t type, const void *blob, size_t size)
+{
+	const char *name = type == MODEL_TYPE_KMEANS ? "k-means" : "Neural network";
+	int (*load)(const struct model_header *hdr) =
+		type == MODEL_TYPE_KMEANS ? kmeansLoadModel : initializeNeuralNetwork;
+	uint8_t *slot;
+	int err;
+
+	if (type != MODEL_TYPE_KMEANS && type != MODEL_TYPE_DENSE) {
+		return -EINVAL;
+	}
+	if (size > sizeof(swap_slot[0])) {
+		return -ENOMEM;
+	}
+
+	/* Validate and load from the caller's buffer first: the slot may hold
+	 * the live model, so it is only overwritten by one known to fit.
+	 */
+	err = loadModel(name, blob, size, type, load);
+	if (err) {
+		return err;
+	}
+
+	slot = swap_slot[type - MODEL_TYPE_KMEANS];
+	memcpy(slot, blob, size);
+	return loadModel(name, slot, size, type, load);
+}
+
+int restoreModels(void)
+{
+	return loadModels();
+}
+
+#if defined(CONFIG_APP_MODEL_SWAP_SHELL)
+
+/* A blob arrives in hex over several shell lines and is swapped in on the
+ * classification thread, between runs. The buffer is left alone from
+ * "model commit" until the swap is done.
+ */
+static uint8_t staging[CONFIG_APP_MODEL_SWAP_MAX_SIZE] __aligned(4);
+static uint8_t staging_type;
+static size_t staging_size;
+static size_t staging_used;
+static atomic_t staging_busy;
+
+int swapStagedModel(void)
+{
+	int err = swapModel(staging_type, staging, staging_size);
+
+	/* The same blob cannot be committed twice without a new transfer */
+	staging_size = 0;
+	atomic_clear(&staging_busy);
+	return err;
+}
+
+static int cmdModelBegin(const struct shell *sh, size_t argc, char **argv)
+{
+	unsigned long size;
+	int err = 0;
+
+	if (atomic_get(&staging_busy)) {
+		shell_error(sh, "a swap is still pending");
+		return -EBUSY;
+	}
+	if (strcmp(argv[1], "kmeans") == 0) {
+		staging_type = MODEL_TYPE_KMEANS;
+	} else if (strcmp(argv[1], "dense") == 0) {
+		staging_type = MODEL_TYPE_DENSE;
+	} else {
+		shell_error(sh, "model type must be kmeans or dense");
+		return -EINVAL;
+	}
+	size = shell_strtoul(argv[2], 10, &err);
+	if (err || size == 0 || size > sizeof(staging)) {
+		shell_error(sh, "size must be 1..%u bytes", (unsigned int)sizeof(staging));
+		return -EINVAL;
+	}
+
+	staging_size = size;
+	staging_used = 0;
+	return 0;
+}
+
+static int cmdModelData(const struct shell *sh, size_t argc, char **argv)
+{
+	size_t len = strlen(argv[1]);
+	size_t n;
+
+	if (atomic_get(&staging_busy) || staging_size == 0) {
+		shell_error(sh, "no transfer started, use model begin");
+		return -EINVAL;
+	}
+	if (len % 2 || len / 2 > staging_size - staging_used) {
+		shell_error(sh, "expected at most %u more bytes as hex pairs",
+			    (unsigned int)(staging_size - staging_used));
+		return -EINVAL;
+	}
+	n = hex2bin(argv[1], len, &staging[staging_used], staging_size - staging_used);
+	if (n != len / 2) {
+		shell_error(sh, "not a hex string");
+		return -EINVAL;
+	}
+
+	staging_used += n;
+	shell_print(sh, "%u of %u bytes", (unsigned int)staging_used, (unsigned int)staging_size);
+	return 0;
+}
+
+static int cmdModelCommit(const struct shell *sh, size_t argc, char **argv)
+{
+	int err;
+
+	if (staging_size == 0) {
+		shell_error(sh, "no transfer started, use model begin");
+		return -EINVAL;
+	}
+	if (staging_used != staging_size) {
+		shell_error(sh, "%u of %u bytes received", (unsigned int)staging_used,
+			    (unsigned int)staging_size);
+		return -EINVAL;
+	}
+	if (!atomic_cas(&staging_busy, 0, 1)) {
+		shell_error(sh, "a swap is still pending");
+		return -EBUSY;
+	}
+
+	err = submitClassifyCommand(CLASSIFY_CMD_MODEL_SWAP, -1, 0);
+	if (err) {
+		atomic_clear(&staging_busy);
+	}
+	return err;
+}
+
+static int cmdModelRestore(const struct shell *sh, size_t argc, char **argv)
+{
+	return submitClassifyCommand(CLASSIFY_CMD_MODEL_RESTORE, -1, 0);
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_model,
+	SHELL_CMD_ARG(begin, NULL, "Start a transfer: <kmeans|dense> <size in bytes>",
+		      cmdModelBegin, 3, 0),
+	SHELL_CMD_ARG(data, NULL, "Append blob bytes: <hex>", cmdModelData, 2, 0),
+	SHELL_CMD(commit, NULL, "Check the blob and swap it in", cmdModelCommit),
+	SHELL_CMD(restore, NULL, "Go back to the models in flash", cmdModelRestore),
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(model, &sub_model, "Swap classifier models at runtime", NULL);
+
+#endif
+#endif
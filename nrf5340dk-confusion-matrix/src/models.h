@@ -0,0 +1,30 @@
+#ifndef MODELS_H_KJJ
+#define MODELS_H_KJJ
+
+/* Validates the model blobs embedded from models/ and hands them to the
+ * k-means and neural network classifiers. Must succeed before anything is
+ * classified.
+ */
+int loadModels(void);
+
+#if defined(CONFIG_APP_MODEL_SWAP)
+#include <stddef.h>
+#include <stdint.h>
+
+/* Replaces the model of the given MODEL_TYPE_* with blob, which is checked
+ * and then copied to RAM so the caller's buffer can be reused. On error the
+ * current model stays in use. Not safe against a classification running at
+ * the same time; call it from the classification thread.
+ */
+int swapModel(uint8_t type, const void *blob, size_t size);
+
+/* Goes back to the models in flash */
+int restoreModels(void);
+
+/* swapModel() on the blob received by "model begin/data/commit" on the
+ * shell, for CLASSIFY_CMD_MODEL_SWAP
+ */
+int swapStagedModel(void);
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "classify.h"
+#include "model_format.h"
+#include "neural_float.h"
+#include "neural_network.h"
+
+/* Same float32 blob as the double engine, used without conversion. Every
+ * multiply-add here maps to one VFMA.F32 on the Cortex-M33 FPU.
+ */
+static const struct dense_f32_model *network;
+
+NETWORK_LAYER_0(layer0, float, float, float)
+NETWORK_LAYER_2(layer2, float, float, float)
+NETWORK_LAYER_0_BATCH(layer0, float)
+NETWORK_LAYER_2_BATCH(layer2, float)
+
+static layer0_batch_t batch_input;
+static layer2_batch_t batch_hidden;
+
+int floatNetworkLoad(const struct model_header *model)
+{
+	if (model->quant != MODEL_QUANT_FLOAT32 || model->inputs != INPUT_DATA_SIZE ||
+	    model->hidden != LAYER_0_NEURONS || model->outputs != LAYER_2_NEURONS) {
+		return -EINVAL;
+	}
+
+	network = modelPayload(model);
+	return 0;
+}
+
+float fastExpf(float x)
+{
+	union {
+		float f;
+		int32_t i;
+	} scale;
+	float n, r, p;
+
+	if (x < -87.0f) {
+		return 0.0f;
+	}
+	if (x > 88.0f) {
+		x = 88.0f;
+	}
+
+	/* x = n * ln2 + r with |r| <= ln2 / 2 */
+	n = (float)(int32_t)(x * 1.44269504f + (x < 0.0f ? -0.5f : 0.5f));
+	r = x - n * 0.693145752f - n * 1.42860677e-6f;
+
+	p = 1.0f + r * (1.0f + r * (0.5f + r * (0.166666672f +
+		   r * (0.0416666418f + r * 0.00833503f))));
+
+	/* 2^n straight into the exponent field */
+	scale.i = ((int32_t)n + 127) << 23;
+	return p * scale.f;
+}
+
+void floatForwardLogits(const float input[], float logits[])
+{
+	float hidden[LAYER_2_INPUTS];
+
+	DENSE_RUN(layer0, &network->weights_0, &network->biases_0, input, hidden);
+	DENSE_UNROLL
+	for (int j = 0; j < LAYER_2_INPUTS; j++) {
+		hidden[j] = hidden[j] > 0.0f ? hidden[j] : 0.0f;
+	}
+
+	DENSE_RUN(layer2, &network->weights_2, &network->biases_2, hidden, logits);
+}
+
+void floatSoftmax(float values[])
+{
+	float max_value, sum;
+
+	max_value = values[0];
+	for (int k = 1; k < LAYER_2_NEURONS; k++) {
+		if (values[k] > max_value) {
+			max_value = values[k];
+		}
+	}
+
+	sum = 0.0f;
+	for (int k = 0; k < LAYER_2_NEURONS; k++) {
+		values[k] = fastExpf(values[k] - max_value);
+		sum += values[k];
+	}
+
+	/* One division, then multiplies */
+	sum = 1.0f / sum;
+	for (int k = 0; k < LAYER_2_NEURONS; k++) {
+		values[k] *= sum;
+	}
+}
+
+void floatForwardPass(const float input[], float probabilities[])
+{
+	floatForwardLogits(input, probabilities);
+	floatSoftmax(probabilities);
+}
+
+int logitsArgmax(const float logits[], float *margin)
+{
+	int winner = 0;
+	float runner_up;
+
+	for (int k = 1; k < LAYER_2_NEURONS; k++) {
+		if (logits[k] > logits[winner]) {
+			winner = k;
+		}
+	}
+
+	if (margin != NULL) {
+		runner_up = winner == 0 ? logits[1] : logits[0];
+		for (int k = 0; k < LAYER_2_NEURONS; k++) {
+			if (k != winner && logits[k] > runner_up) {
+				runner_up = logits[k];
+			}
+		}
+		*margin = logits[winner] - runner_up;
+	}
+	return winner;
+}
+
+int floatPredictClass(float x, float y, float z)
+{
+	float input[INPUT_DATA_SIZE] = {x, y, z};
+	float logits[LAYER_2_NEURONS];
+
+	floatForwardLogits(input, logits);
+	return logitsArgmax(logits, NULL);
+}
+
+int floatPredictConfidence(float x, float y, float z, float *margin, float probabilities[])
+{
+	float input[INPUT_DATA_SIZE] = {x, y, z};
+	float logits[LAYER_2_NEURONS];
+	int winner;
+
+	floatForwardLogits(input, logits);
+	winner = logitsArgmax(logits, margin);
+	if (probabilities != NULL) {
+		for (int k = 0; k < LAYER_2_NEURONS; k++) {
+			probabilities[k] = logits[k];
+		}
+		floatSoftmax(probabilities);
+	}
+	return winner;
+}
+
+/* Each layer runs over a chunk of samples with the sample loop innermost, and
+ * the argmax is kept per sample as each class's output row is produced.
+ */
+void floatPredictBatch(const struct measurement_soa *in, uint8_t *labels)
+{
+	for (size_t base = 0; base < in->count; base += NN_BATCH_CHUNK) {
+		int n = in->count - base < NN_BATCH_CHUNK ? (int)(in->count - base) : NN_BATCH_CHUNK;
+		float row[NN_BATCH_CHUNK];
+		float best[NN_BATCH_CHUNK];
+		uint8_t winner[NN_BATCH_CHUNK];
+
+		for (int s = 0; s < n; s++) {
+			batch_input[0][s] = in->x[base + s];
+			batch_input[1][s] = in->y[base + s];
+			batch_input[2][s] = in->z[base + s];
+		}
+
+		for (int j = 0; j < LAYER_2_INPUTS; j++) {
+			DENSE_RUN_BATCH(layer0, &network->weights_0, &network->biases_0, j, n,
+					&batch_input, row);
+			for (int s = 0; s < n; s++) {
+				batch_hidden[j][s] = row[s] > 0.0f ? row[s] : 0.0f;
+			}
+		}
+
+		for (int k = 0; k < LAYER_2_NEURONS; k++) {
+			DENSE_RUN_BATCH(layer2, &network->weights_2, &network->biases_2, k, n,
+					&batch_hidden, row);
+			for (int s = 0; s < n; s++) {
+				int better = k == 0 || row[s] > best[s];
+
+				best[s] = better ? row[s] : best[s];
+				winner[s] = better ? (uint8_t)k : winner[s];
+			}
+		}
+
+		memcpy(labels + base, winner, n);
+	}
+}
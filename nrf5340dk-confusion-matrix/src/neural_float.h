@@ -0,0 +1,47 @@
+#ifndef NEURAL_FLOAT_H_KJJ
+#define NEURAL_FLOAT_H_KJJ
+
+#include <stdint.h>
+
+struct model_header;
+struct measurement_soa;
+
+/* Takes the weights of a checked MODEL_TYPE_DENSE / MODEL_QUANT_FLOAT32 blob,
+ * which must stay valid afterwards. Returns -EINVAL if its layer sizes differ
+ * from neural_network.h.
+ */
+int floatNetworkLoad(const struct model_header *model);
+
+/* Single precision output layer before softmax; logits has LAYER_2_NEURONS
+ * entries.
+ */
+void floatForwardLogits(const float input[], float logits[]);
+
+/* Single precision forward pass with softmax; probabilities has
+ * LAYER_2_NEURONS entries.
+ */
+void floatForwardPass(const float input[], float probabilities[]);
+
+/* Argmax of the logits, no softmax */
+int floatPredictClass(float x, float y, float z);
+
+/* floatPredictClass() for every sample of the block; same labels */
+void floatPredictBatch(const struct measurement_soa *in, uint8_t *labels);
+
+/* As predictClassWithConfidence() in neural_network.h */
+int floatPredictConfidence(float x, float y, float z, float *margin, float probabilities[]);
+
+/* In-place softmax over LAYER_2_NEURONS values */
+void floatSoftmax(float values[]);
+
+/* Index of the largest of LAYER_2_NEURONS logits; margin (if not NULL)
+ * receives its lead over the runner-up.
+ */
+int logitsArgmax(const float logits[], float *margin);
+
+/* exp() for the softmax: range reduction to 2^n * e^r with a degree 5
+ * polynomial, relative error below 4e-6 over the float range.
+ */
+float fastExpf(float x);
+
+#endif
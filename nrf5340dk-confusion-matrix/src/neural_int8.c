@@ -0,0 +1,274 @@
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#if defined(__ARM_FEATURE_DSP) && defined(__ARM_FEATURE_SIMD32)
+#include <arm_acle.h>
+#endif
+#include "classify.h"
+#include "model_format.h"
+#include "neural_float.h"
+#include "neural_int8.h"
+#include "neural_network.h"
+
+static const struct dense_int8_model *network;
+static int requant_shift;
+
+_Static_assert(offsetof(struct dense_int8_model, weights_0) ==
+		       sizeof(float) + (2 * LAYER_0_NEURONS + LAYER_2_NEURONS) * sizeof(int32_t),
+	       "struct dense_int8_model does not match the MODEL_QUANT_INT8 layout");
+
+#if defined(__ARM_FEATURE_DSP) && defined(__ARM_FEATURE_SIMD32)
+
+/* Cortex-M33 DSP extension: SXTB16 sign-extends two int8 weights of a word
+ * into 16-bit lanes and SMLAD multiplies them with two 16-bit activations and
+ * adds both products, so one instruction does two multiply-adds. Activations
+ * fit a lane: inputs are at most QUANTIZED_MAX_INPUT_MV and hidden values
+ * 0..127.
+ */
+NETWORK_LAYER_0_TENSORS(layer0, int8_t, int32_t);
+NETWORK_LAYER_2_TENSORS(layer2, int8_t, int32_t);
+
+_Static_assert(LAYER_0_INPUTS == 3, "the DSP layer 0 packs exactly x, y and z");
+
+static inline int16x2_t packLanes(int32_t low, int32_t high)
+{
+	return (int16x2_t)(((uint32_t)high << 16) | (uint16_t)low);
+}
+
+static inline uint32_t loadWeights(const int8_t *weights)
+{
+	uint32_t word;
+
+	/* Rows are not word aligned; the M33 loads unaligned words directly */
+	memcpy(&word, weights, sizeof(word));
+	return word;
+}
+
+/* A word of weights (w0, w1, w2, w3) splits into lanes (w0, w2) with SXTB16
+ * and (w1, w3) with SXTB16 of the word rotated by 8 bits.
+ */
+static inline int32_t dotWord(uint32_t word, int16x2_t even, int16x2_t odd, int32_t acc)
+{
+	acc = __smlad(__sxtb16((int8x4_t)word), even, acc);
+	return __smlad(__sxtb16((int8x4_t)__ror(word, 8)), odd, acc);
+}
+
+/* Each 3-weight row is loaded as one word whose fourth byte is the next
+ * row's first weight; it meets the zero lane of (y, 0) and adds nothing. The
+ * last row has no next row and is assembled from its three bytes.
+ */
+static inline void layer0_kernel(const layer0_weights_t *w, const layer0_biases_t *b,
+				 const int32_t in[LAYER_0_INPUTS], int32_t out[LAYER_0_NEURONS])
+{
+	int16x2_t xz = packLanes(in[0], in[2]);
+	int16x2_t y0 = packLanes(in[1], 0);
+	const int8_t *last = (*w)[LAYER_0_NEURONS - 1];
+
+	DENSE_UNROLL
+	for (int o = 0; o < LAYER_0_NEURONS - 1; o++) {
+		out[o] = dotWord(loadWeights((*w)[o]), xz, y0, (*b)[o]);
+	}
+	out[LAYER_0_NEURONS - 1] =
+		dotWord((uint8_t)last[0] | (uint32_t)(uint8_t)last[1] << 8 |
+				(uint32_t)(uint8_t)last[2] << 16,
+			xz, y0, (*b)[LAYER_0_NEURONS - 1]);
+}
+
+#define LAYER_2_WORDS (LAYER_2_INPUTS / 4)
+
+/* The hidden values are packed once into the (h0, h2) and (h1, h3) lane
+ * pairs of each word, then every output costs one load and two SMLADs per
+ * four weights plus a scalar tail for the remaining LAYER_2_INPUTS % 4.
+ */
+static inline void layer2_kernel(const layer2_weights_t *w, const layer2_biases_t *b,
+				 const int32_t in[LAYER_2_INPUTS], int32_t out[LAYER_2_NEURONS])
+{
+	int16x2_t even[LAYER_2_WORDS];
+	int16x2_t odd[LAYER_2_WORDS];
+
+	DENSE_UNROLL
+	for (int q = 0; q < LAYER_2_WORDS; q++) {
+		even[q] = packLanes(in[4 * q], in[4 * q + 2]);
+		odd[q] = packLanes(in[4 * q + 1], in[4 * q + 3]);
+	}
+
+	for (int o = 0; o < LAYER_2_NEURONS; o++) {
+		const int8_t *row = (*w)[o];
+		int32_t acc = (*b)[o];
+
+		DENSE_UNROLL
+		for (int q = 0; q < LAYER_2_WORDS; q++) {
+			acc = dotWord(loadWeights(row + 4 * q), even[q], odd[q], acc);
+		}
+		DENSE_UNROLL
+		for (int i = 4 * LAYER_2_WORDS; i < LAYER_2_INPUTS; i++) {
+			acc += row[i] * in[i];
+		}
+		out[o] = acc;
+	}
+}
+
+#else
+
+NETWORK_LAYER_0(layer0, int8_t, int32_t, int32_t)
+NETWORK_LAYER_2(layer2, int8_t, int32_t, int32_t)
+NETWORK_LAYER_0_BATCH(layer0, int32_t)
+NETWORK_LAYER_2_BATCH(layer2, int32_t)
+
+static layer0_batch_t batch_input;
+static layer2_batch_t batch_hidden;
+
+#endif
+
+int quantizedNetworkLoad(const struct model_header *model)
+{
+	if (model->quant != MODEL_QUANT_INT8 || model->inputs != INPUT_DATA_SIZE ||
+	    model->hidden != LAYER_0_NEURONS || model->outputs != LAYER_2_NEURONS ||
+	    model->frac_bits == 0) {
+		return -EINVAL;
+	}
+
+	network = modelPayload(model);
+	requant_shift = model->frac_bits;
+	return 0;
+}
+
+static inline int32_t clampInput(int32_t value_mv)
+{
+	if (value_mv < 0) {
+		return 0;
+	}
+	return value_mv > QUANTIZED_MAX_INPUT_MV ? QUANTIZED_MAX_INPUT_MV : value_mv;
+}
+
+/* Integer ReLU, then rescale to the neuron's 0..127 activation range */
+static inline int32_t requantize(int32_t acc, int32_t multiplier, int64_t round)
+{
+	int64_t h = ((int64_t)acc * multiplier + round) >> requant_shift;
+
+	return acc <= 0 ? 0 : (h > INT8_MAX ? INT8_MAX : (int32_t)h);
+}
+
+static void quantizedLogits(int32_t x, int32_t y, int32_t z, int32_t output[])
+{
+	int32_t input[INPUT_DATA_SIZE] = {clampInput(x), clampInput(y), clampInput(z)};
+	int32_t hidden[LAYER_2_INPUTS];
+	int64_t round = (int64_t)1 << (requant_shift - 1);
+
+	/* |w| <= 127 and inputs below 2^13 keep each sum below 2^22 */
+	DENSE_RUN(layer0, &network->weights_0, &network->biases_0, input, hidden);
+
+	DENSE_UNROLL
+	for (int j = 0; j < LAYER_2_INPUTS; j++) {
+		hidden[j] = requantize(hidden[j], network->multipliers_0[j], round);
+	}
+
+	/* Every class shares one scale, so comparing the accumulators gives the
+	 * same winner as softmax over the dequantized outputs.
+	 */
+	DENSE_RUN(layer2, &network->weights_2, &network->biases_2, hidden, output);
+}
+
+int quantizedPredictClass(int32_t x, int32_t y, int32_t z)
+{
+	int32_t output[LAYER_2_NEURONS];
+	int winner = 0;
+
+	quantizedLogits(x, y, z, output);
+	for (int k = 1; k < LAYER_2_NEURONS; k++) {
+		if (output[k] > output[winner]) {
+			winner = k;
+		}
+	}
+	return winner;
+}
+
+#if defined(__ARM_FEATURE_DSP) && defined(__ARM_FEATURE_SIMD32)
+
+/* The DSP kernels already pack each sample's activations into lanes, which
+ * is where batching pays off, so a batch is a loop over samples.
+ */
+void quantizedPredictBatch(const struct measurement_soa *in, uint8_t *labels)
+{
+	for (size_t i = 0; i < in->count; i++) {
+		labels[i] = (uint8_t)quantizedPredictClass(in->x[i], in->y[i], in->z[i]);
+	}
+}
+
+#else
+
+/* Portable version: each layer runs over a chunk of samples with the sample
+ * loop innermost, and the argmax is kept per sample as each class's output
+ * row is produced.
+ */
+void quantizedPredictBatch(const struct measurement_soa *in, uint8_t *labels)
+{
+	int64_t round = (int64_t)1 << (requant_shift - 1);
+
+	for (size_t base = 0; base < in->count; base += NN_BATCH_CHUNK) {
+		int n = in->count - base < NN_BATCH_CHUNK ? (int)(in->count - base) : NN_BATCH_CHUNK;
+		int32_t row[NN_BATCH_CHUNK];
+		int32_t best[NN_BATCH_CHUNK];
+		uint8_t winner[NN_BATCH_CHUNK];
+
+		/* measurement_soa values are already within 0..QUANTIZED_MAX_INPUT_MV */
+		for (int s = 0; s < n; s++) {
+			batch_input[0][s] = in->x[base + s];
+			batch_input[1][s] = in->y[base + s];
+			batch_input[2][s] = in->z[base + s];
+		}
+
+		for (int j = 0; j < LAYER_2_INPUTS; j++) {
+			int32_t multiplier = network->multipliers_0[j];
+
+			DENSE_RUN_BATCH(layer0, &network->weights_0, &network->biases_0, j, n,
+					&batch_input, row);
+			for (int s = 0; s < n; s++) {
+				batch_hidden[j][s] = requantize(row[s], multiplier, round);
+			}
+		}
+
+		for (int k = 0; k < LAYER_2_NEURONS; k++) {
+			DENSE_RUN_BATCH(layer2, &network->weights_2, &network->biases_2, k, n,
+					&batch_hidden, row);
+			for (int s = 0; s < n; s++) {
+				int better = k == 0 || row[s] > best[s];
+
+				best[s] = better ? row[s] : best[s];
+				winner[s] = better ? (uint8_t)k : winner[s];
+			}
+		}
+
+		memcpy(labels + base, winner, n);
+	}
+}
+
+#endif
+
+/* Dequantizes only here, off the per-sample path */
+void quantizedForwardLogits(int32_t x, int32_t y, int32_t z, float logits[])
+{
+	int32_t output[LAYER_2_NEURONS];
+
+	quantizedLogits(x, y, z, output);
+	for (int k = 0; k < LAYER_2_NEURONS; k++) {
+		logits[k] = output[k] * network->output_scale;
+	}
+}
+
+int quantizedPredictConfidence(int32_t x, int32_t y, int32_t z, float *margin,
+			       float probabilities[])
+{
+	float logits[LAYER_2_NEURONS];
+	int winner;
+
+	quantizedForwardLogits(x, y, z, logits);
+	winner = logitsArgmax(logits, margin);
+	if (probabilities != NULL) {
+		for (int k = 0; k < LAYER_2_NEURONS; k++) {
+			probabilities[k] = logits[k];
+		}
+		floatSoftmax(probabilities);
+	}
+	return winner;
+}
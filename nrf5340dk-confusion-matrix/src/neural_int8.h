@@ -0,0 +1,48 @@
+#ifndef NEURAL_INT8_H_KJJ
+#define NEURAL_INT8_H_KJJ
+
+#include <stdint.h>
+#include "neural_network.h"
+
+struct model_header;
+struct measurement_soa;
+
+/* MODEL_TYPE_DENSE / MODEL_QUANT_INT8 payload (model_format.h), used in place */
+struct dense_int8_model {
+	float output_scale;
+	int32_t biases_0[LAYER_0_NEURONS];
+	int32_t multipliers_0[LAYER_0_NEURONS];
+	int32_t biases_2[LAYER_2_NEURONS];
+	int8_t weights_0[LAYER_0_NEURONS][LAYER_0_INPUTS];
+	int8_t weights_2[LAYER_2_NEURONS][LAYER_2_INPUTS];
+};
+
+/* Largest input in millivolts; keeps the layer 0 accumulators far from
+ * overflowing int32.
+ */
+#define QUANTIZED_MAX_INPUT_MV 8191
+
+/* Takes the tensors of a checked MODEL_TYPE_DENSE / MODEL_QUANT_INT8 blob,
+ * which must stay valid afterwards. Returns -EINVAL if its layer sizes differ
+ * from neural_network.h.
+ */
+int quantizedNetworkLoad(const struct model_header *model);
+
+/* Int8 weights, int32 accumulators, no floating point. Returns the class. */
+int quantizedPredictClass(int32_t x, int32_t y, int32_t z);
+
+/* quantizedPredictClass() for every sample of the block; same labels */
+void quantizedPredictBatch(const struct measurement_soa *in, uint8_t *labels);
+
+/* Output layer before softmax, dequantized with the blob's output scale;
+ * logits has LAYER_2_NEURONS entries.
+ */
+void quantizedForwardLogits(int32_t x, int32_t y, int32_t z, float logits[]);
+
+/* As predictClassWithConfidence() in neural_network.h; the outputs are
+ * dequantized with the blob's output scale and softmax runs in float.
+ */
+int quantizedPredictConfidence(int32_t x, int32_t y, int32_t z, float *margin,
+			       float probabilities[]);
+
+#endif
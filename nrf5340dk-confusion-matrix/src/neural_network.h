@@ -0,0 +1,83 @@
+#ifndef NEURAL_NETWORK_H
+#define NEURAL_NETWORK_H
+
+#include "classify.h"
+#include "dense_kernel.h"
+
+// Network description: Dense(22, relu) -> Dense(CLASS_COUNT, softmax) trained on
+// x, y, z in millivolts. Each dense layer states its own inputs and outputs;
+// DENSE_CHAIN checks that they connect, every engine generates its kernels
+// from these sizes and the model blob is checked against them at boot.
+#define INPUT_DATA_SIZE 3
+#define LAYER_0_INPUTS 3
+#define LAYER_0_NEURONS 22
+// Layer 1 is the ReLU, which keeps the width of layer 0
+#define LAYER_2_INPUTS 22
+#define LAYER_2_NEURONS CLASS_COUNT
+
+DENSE_CHAIN(INPUT_DATA_SIZE, LAYER_0_INPUTS);
+DENSE_CHAIN(LAYER_0_NEURONS, LAYER_2_INPUTS);
+
+#define NETWORK_LAYER_0(name, weight_t, bias_t, acc_t) \
+    DENSE_KERNEL(name, weight_t, bias_t, acc_t, LAYER_0_INPUTS, LAYER_0_NEURONS)
+#define NETWORK_LAYER_2(name, weight_t, bias_t, acc_t) \
+    DENSE_KERNEL(name, weight_t, bias_t, acc_t, LAYER_2_INPUTS, LAYER_2_NEURONS)
+#define NETWORK_LAYER_0_TENSORS(name, weight_t, bias_t) \
+    DENSE_TENSORS(name, weight_t, bias_t, LAYER_0_INPUTS, LAYER_0_NEURONS)
+#define NETWORK_LAYER_2_TENSORS(name, weight_t, bias_t) \
+    DENSE_TENSORS(name, weight_t, bias_t, LAYER_2_INPUTS, LAYER_2_NEURONS)
+
+// Samples per chunk of the batch paths (predictClassBatch()). Each engine
+// keeps its layer inputs for one chunk in static buffers, which only the
+// classification thread uses.
+#define NN_BATCH_CHUNK 16
+#define NETWORK_LAYER_0_BATCH(name, acc_t) DENSE_BATCH(name, acc_t, LAYER_0_INPUTS, NN_BATCH_CHUNK)
+#define NETWORK_LAYER_2_BATCH(name, acc_t) DENSE_BATCH(name, acc_t, LAYER_2_INPUTS, NN_BATCH_CHUNK)
+
+/* MODEL_TYPE_DENSE / MODEL_QUANT_FLOAT32 payload (model_format.h), used in
+ * place by the double and float engines
+ */
+struct dense_f32_model
+{
+    float weights_0[LAYER_0_NEURONS][LAYER_0_INPUTS];
+    float biases_0[LAYER_0_NEURONS];
+    float weights_2[LAYER_2_NEURONS][LAYER_2_INPUTS];
+    float biases_2[LAYER_2_NEURONS];
+};
+
+struct model_header;
+
+/* Takes the weights from a checked MODEL_TYPE_DENSE blob, which must stay
+ * valid afterwards. Returns -EINVAL if its layer sizes differ from the ones
+ * above.
+ */
+int initializeNeuralNetwork(const struct model_header *model);
+
+/* Class only: argmax of the output layer before softmax, which cannot change
+ * the winner. This is the per-sample path.
+ */
+int predictClass(double x, double y, double z);
+
+/* Class plus, on request, how sure the network is. margin (if not NULL)
+ * receives the winning output minus the runner-up before softmax; 0 means a
+ * tie. probabilities (if not NULL, LAYER_2_NEURONS entries) receives the
+ * softmax output.
+ */
+int predictClassWithConfidence(double x, double y, double z, float *margin, float probabilities[]);
+
+/* The double engine on its own, whichever engine CONFIG_APP_NN_* selects
+ * above; for comparing the engines on target (nn_bench.c).
+ */
+int referenceNetworkLoad(const struct model_header *model);
+int referencePredictClass(double x, double y, double z);
+int referencePredictConfidence(double x, double y, double z, float *margin, float probabilities[]);
+void referencePredictBatch(const struct measurement_soa *in, uint8_t *labels);
+
+double relu(double activation);
+void softmax(double final_output[], int size);
+void forward_logits(const double input[], double logits[], const struct dense_f32_model *model);
+void forward_pass(const double input[], double predictions[], const struct dense_f32_model *model);
+int get_predicted_class(double predictions[], int size);
+
+
+#endif
@@ -0,0 +1,172 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/timing/timing.h>
+#include "classify.h"
+#include "model_format.h"
+#include "neural_float.h"
+#include "neural_int8.h"
+#include "neural_network.h"
+#include "nn_bench.h"
+
+LOG_MODULE_DECLARE(MAIN, CONFIG_APP_LOG_LEVEL);
+
+/* Samples per pass and timed passes per engine */
+#define BENCH_SAMPLES 128
+#define BENCH_PASSES 4
+
+/* int8 is meant to classify at least this many times faster than double */
+#define BENCH_TARGET_SPEEDUP 10
+
+/* Inputs are spread over the range of the capture in neural-kmeans-c */
+#define BENCH_MIN_MV 1200
+#define BENCH_SPAN_MV 900
+
+static const uint8_t dense_blob[] __aligned(4) = {
+#include "model_dense.inc"
+};
+
+static const uint8_t dense_int8_blob[] __aligned(4) = {
+#include "model_dense_int8.inc"
+};
+
+enum bench_engine {
+	BENCH_DOUBLE,
+	BENCH_FLOAT,
+	BENCH_INT8,
+	BENCH_ENGINES
+};
+
+static int16_t bench_x[BENCH_SAMPLES];
+static int16_t bench_y[BENCH_SAMPLES];
+static int16_t bench_z[BENCH_SAMPLES];
+static struct measurement_soa soa;
+static uint8_t reference_labels[BENCH_SAMPLES];
+static uint8_t labels[BENCH_SAMPLES];
+
+static int runReference(int i)
+{
+	return referencePredictClass(bench_x[i], bench_y[i], bench_z[i]);
+}
+
+static int runFloat(int i)
+{
+	return floatPredictClass(bench_x[i], bench_y[i], bench_z[i]);
+}
+
+static int runInt8(int i)
+{
+	return quantizedPredictClass(bench_x[i], bench_y[i], bench_z[i]);
+}
+
+static const struct engine {
+	const char *name;
+	const uint8_t *blob;
+	size_t size;
+	int (*load)(const struct model_header *hdr);
+	int (*predict)(int i);
+	void (*batch)(const struct measurement_soa *in, uint8_t *labels);
+} engines[BENCH_ENGINES] = {
+	[BENCH_DOUBLE] = {"double", dense_blob, sizeof(dense_blob), referenceNetworkLoad,
+			  runReference, referencePredictBatch},
+	[BENCH_FLOAT] = {"float", dense_blob, sizeof(dense_blob), floatNetworkLoad, runFloat,
+			 floatPredictBatch},
+	[BENCH_INT8] = {"int8", dense_int8_blob, sizeof(dense_int8_blob), quantizedNetworkLoad,
+			runInt8, quantizedPredictBatch},
+};
+
+static uint32_t cyclesPerSample(timing_t *start, timing_t *end)
+{
+	return (uint32_t)(timing_cycles_get(start, end) / (BENCH_SAMPLES * BENCH_PASSES));
+}
+
+static int timeEngine(const struct engine *e, uint32_t *per_sample, uint32_t *batched)
+{
+	const struct model_header *hdr;
+	volatile int sink = 0;
+	timing_t start, end;
+	int err;
+
+	err = modelCheck(e->blob, e->size, MODEL_TYPE_DENSE, &hdr);
+	if (!err) {
+		err = e->load(hdr);
+	}
+	if (err) {
+		LOG_ERR("NN bench: %s model rejected (err %d)", e->name, err);
+		return err;
+	}
+
+	start = timing_counter_get();
+	for (int pass = 0; pass < BENCH_PASSES; pass++) {
+		for (int i = 0; i < BENCH_SAMPLES; i++) {
+			sink += e->predict(i);
+		}
+	}
+	end = timing_counter_get();
+	*per_sample = cyclesPerSample(&start, &end);
+
+	start = timing_counter_get();
+	for (int pass = 0; pass < BENCH_PASSES; pass++) {
+		e->batch(&soa, labels);
+	}
+	end = timing_counter_get();
+	*batched = cyclesPerSample(&start, &end);
+
+	(void)sink;
+	return 0;
+}
+
+void nnBenchRun(void)
+{
+	uint32_t per_sample[BENCH_ENGINES];
+	uint32_t batched[BENCH_ENGINES];
+	uint32_t seed = 1;
+	uint32_t speedup;
+	uint32_t float_speedup;
+
+	for (int i = 0; i < BENCH_SAMPLES; i++) {
+		int16_t *axis[] = {&bench_x[i], &bench_y[i], &bench_z[i]};
+
+		for (size_t d = 0; d < ARRAY_SIZE(axis); d++) {
+			seed = seed * 1664525u + 1013904223u;
+			*axis[d] = BENCH_MIN_MV + (seed >> 16) % BENCH_SPAN_MV;
+		}
+	}
+	soa.x = bench_x;
+	soa.y = bench_y;
+	soa.z = bench_z;
+	soa.count = BENCH_SAMPLES;
+
+	timing_init();
+	timing_start();
+
+	for (int e = 0; e < BENCH_ENGINES; e++) {
+		int agree = 0;
+
+		if (timeEngine(&engines[e], &per_sample[e], &batched[e])) {
+			return;
+		}
+		if (e == BENCH_DOUBLE) {
+			memcpy(reference_labels, labels, sizeof(labels));
+		}
+		for (int i = 0; i < BENCH_SAMPLES; i++) {
+			agree += labels[i] == reference_labels[i];
+		}
+		LOG_INF("NN bench %s: %u cycles per sample, %u batched, %d/%d labels as double",
+			engines[e].name, per_sample[e], batched[e], agree, BENCH_SAMPLES);
+	}
+
+	/* In tenths, on the batch path the confusion matrix runs */
+	float_speedup = batched[BENCH_DOUBLE] * 10 / MAX(batched[BENCH_FLOAT], 1);
+	speedup = batched[BENCH_DOUBLE] * 10 / MAX(batched[BENCH_INT8], 1);
+	LOG_INF("NN bench: float is %u.%ux faster than double", float_speedup / 10,
+		float_speedup % 10);
+	if (speedup >= BENCH_TARGET_SPEEDUP * 10) {
+		LOG_INF("NN bench: int8 is %u.%ux faster than double, target %dx met", speedup / 10,
+			speedup % 10, BENCH_TARGET_SPEEDUP);
+	} else {
+		LOG_WRN("NN bench: int8 is only %u.%ux faster than double, target %dx", speedup / 10,
+			speedup % 10, BENCH_TARGET_SPEEDUP);
+	}
+}
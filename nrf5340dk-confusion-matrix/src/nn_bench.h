@@ -0,0 +1,10 @@
+#ifndef NN_BENCH_H_KJJ
+#define NN_BENCH_H_KJJ
+
+/* Times every network engine on the same inputs and logs cycles per
+ * inference and the speed-up over double. Loads its own copies of the
+ * models into the engines, so it must run before loadModels().
+ */
+void nnBenchRun(void);
+
+#endif
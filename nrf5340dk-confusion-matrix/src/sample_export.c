@@ -0,0 +1,177 @@
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/atomic.h>
+#if defined(CONFIG_APP_SAMPLE_EXPORT_RTT)
+#include <SEGGER_RTT.h>
+#else
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/ring_buffer.h>
+#endif
+#include "export_format.h"
+#include "metrics.h"
+#include "sample_export.h"
+
+LOG_MODULE_DECLARE(MAIN, CONFIG_APP_LOG_LEVEL);
+
+BUILD_ASSERT(sizeof(struct export_header) == EXPORT_FRAME_SIZE);
+BUILD_ASSERT(sizeof(struct export_sample) == EXPORT_FRAME_SIZE);
+
+/* The replay thread and the classification thread both export. Numbering
+ * a frame and queueing it is one step under this mutex, so frames reach the
+ * host in sequence order with no number used twice. Only threads export, and
+ * the RTT write may itself take a mutex, so this is not a spinlock.
+ */
+static K_MUTEX_DEFINE(export_lock);
+static uint16_t seq;
+static atomic_t dropped;
+
+#if defined(CONFIG_APP_SAMPLE_EXPORT_RTT)
+
+static uint8_t rtt_buffer[CONFIG_APP_SAMPLE_EXPORT_BUFFER_SIZE];
+
+static int backendInit(void)
+{
+	int err = SEGGER_RTT_ConfigUpBuffer(CONFIG_APP_SAMPLE_EXPORT_RTT_CHANNEL, "samples",
+					    rtt_buffer, sizeof(rtt_buffer),
+					    SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+
+	return err < 0 ? -EIO : 0;
+}
+
+static bool backendWrite(const void *frame)
+{
+	return SEGGER_RTT_Write(CONFIG_APP_SAMPLE_EXPORT_RTT_CHANNEL, frame, EXPORT_FRAME_SIZE) ==
+	       EXPORT_FRAME_SIZE;
+}
+
+#else
+
+#if DT_HAS_CHOSEN(app_export_uart)
+static const struct device *const uart = DEVICE_DT_GET(DT_CHOSEN(app_export_uart));
+#else
+static const struct device *const uart = DEVICE_DT_GET(DT_CHOSEN(zephyr_console));
+#endif
+
+RING_BUF_DECLARE(tx_ring, CONFIG_APP_SAMPLE_EXPORT_BUFFER_SIZE);
+static struct k_spinlock tx_lock;
+
+/* Feeds the TX FIFO from the ring buffer until it runs dry */
+static void uartIsr(const struct device *dev, void *user_data)
+{
+	if (!uart_irq_update(dev) || !uart_irq_tx_ready(dev)) {
+		return;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&tx_lock);
+	uint8_t *data;
+	uint32_t len = ring_buf_get_claim(&tx_ring, &data, CONFIG_APP_SAMPLE_EXPORT_BUFFER_SIZE);
+
+	if (len == 0) {
+		uart_irq_tx_disable(dev);
+	} else {
+		int sent = uart_fifo_fill(dev, data, len);
+
+		ring_buf_get_finish(&tx_ring, MAX(sent, 0));
+	}
+	k_spin_unlock(&tx_lock, key);
+}
+
+static int backendInit(void)
+{
+	if (!device_is_ready(uart)) {
+		return -ENODEV;
+	}
+	return uart_irq_callback_user_data_set(uart, uartIsr, NULL);
+}
+
+static bool backendWrite(const void *frame)
+{
+	k_spinlock_key_t key = k_spin_lock(&tx_lock);
+	bool fits = ring_buf_space_get(&tx_ring) >= EXPORT_FRAME_SIZE;
+
+	if (fits) {
+		ring_buf_put(&tx_ring, frame, EXPORT_FRAME_SIZE);
+	}
+	k_spin_unlock(&tx_lock, key);
+
+	if (fits) {
+		uart_irq_tx_enable(uart);
+	}
+	return fits;
+}
+
+#endif
+
+/* Called with export_lock held */
+static void writeHeader(void)
+{
+	struct export_header hdr = {
+		.sync = EXPORT_SYNC_HEADER,
+		.version = EXPORT_FORMAT_VERSION,
+		.classes = METRICS_CLASSES,
+		.magic = EXPORT_MAGIC,
+		.timestamp_hz = sys_clock_hw_cycles_per_sec(),
+		.seq = seq,
+	};
+
+	hdr.crc8 = exportCrc8(&hdr);
+	if (!backendWrite(&hdr)) {
+		atomic_inc(&dropped);
+	}
+}
+
+int sampleExportInit(void)
+{
+	int err = backendInit();
+
+	if (err) {
+		LOG_ERR("Sample export backend not available (err %d)", err);
+		return err;
+	}
+
+	k_mutex_lock(&export_lock, K_FOREVER);
+	writeHeader();
+	k_mutex_unlock(&export_lock);
+	return 0;
+}
+
+void sampleExport(int actual, int predicted, struct Measurement m)
+{
+	struct export_sample rec = {
+		.sync = EXPORT_SYNC_SAMPLE,
+		.actual = actual,
+		.predicted = predicted < 0 ? EXPORT_UNCLASSIFIED : predicted,
+		.x = m.x,
+		.y = m.y,
+		.z = m.z,
+	};
+	k_mutex_lock(&export_lock, K_FOREVER);
+	rec.seq = seq;
+	rec.timestamp = k_cycle_get_32();
+	rec.crc8 = exportCrc8(&rec);
+	if (!backendWrite(&rec)) {
+		atomic_inc(&dropped);
+	}
+
+	/* Repeat the header now and then for a reader that attaches late */
+	if (++seq % EXPORT_HEADER_INTERVAL == 0) {
+		writeHeader();
+	}
+	k_mutex_unlock(&export_lock);
+}
+
+void sampleExportBatch(int actual, const struct Measurement *m, const uint8_t *predicted,
+		       size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		sampleExport(actual, predicted[i], m[i]);
+	}
+}
+
+uint32_t sampleExportDropped(void)
+{
+	return atomic_get(&dropped);
+}
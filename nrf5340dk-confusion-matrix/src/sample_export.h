@@ -0,0 +1,23 @@
+#ifndef SAMPLE_EXPORT_H_KJJ
+#define SAMPLE_EXPORT_H_KJJ
+
+#include <stddef.h>
+#include <stdint.h>
+#include "adc.h"
+
+/* Opens the RTT channel or UART and writes the first header frame */
+int sampleExportInit(void);
+
+/* Queue classified samples as export_sample frames, see export_format.h.
+ * Never waits for the backend and may be called from several threads, but
+ * not from an ISR; frames that do not fit in the backend buffer are dropped
+ * and show up as sequence gaps on the host.
+ */
+void sampleExport(int actual, int predicted, struct Measurement m);
+void sampleExportBatch(int actual, const struct Measurement *m, const uint8_t *predicted,
+		       size_t count);
+
+/* Frames dropped because the backend buffer was full */
+uint32_t sampleExportDropped(void);
+
+#endif
@@ -0,0 +1,136 @@
+#include <string.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/spinlock.h>
+#include "stage_stats.h"
+
+struct stage_accumulator {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+	uint32_t histogram[STAGE_HISTOGRAM_BUCKETS];
+};
+
+static const char *const stage_names[STAGE_COUNT] = {
+	[STAGE_ADC_READ] = "adc_read",
+	[STAGE_CLASSIFY] = "classify",
+	[STAGE_NOTIFY] = "notify",
+	[STAGE_LOG] = "log",
+};
+
+static struct stage_accumulator stages[STAGE_COUNT];
+static struct k_spinlock lock;
+
+static inline int bucketOf(uint32_t cycles)
+{
+	/* 256 * 4^b: two bits of log2 per bucket above 2^8 */
+	int bucket = cycles < 256 ? 0 : (32 - __builtin_clz(cycles) - 8 + 1) / 2;
+
+	return bucket < STAGE_HISTOGRAM_BUCKETS ? bucket : STAGE_HISTOGRAM_BUCKETS - 1;
+}
+
+void stageRecord(enum stage stage, uint32_t cycles)
+{
+	struct stage_accumulator *s = &stages[stage];
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (s->count == 0 || cycles < s->min) {
+		s->min = cycles;
+	}
+	if (cycles > s->max) {
+		s->max = cycles;
+	}
+	s->count++;
+	s->total += cycles;
+	s->histogram[bucketOf(cycles)]++;
+
+	k_spin_unlock(&lock, key);
+}
+
+void stageStatsGet(enum stage stage, struct stage_stats *out)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct stage_accumulator s = stages[stage];
+
+	k_spin_unlock(&lock, key);
+
+	out->count = s.count;
+	out->min = s.min;
+	out->max = s.max;
+	out->mean = s.count ? (uint32_t)(s.total / s.count) : 0;
+	for (int b = 0; b < STAGE_HISTOGRAM_BUCKETS; b++) {
+		out->histogram[b] = s.histogram[b];
+	}
+}
+
+void stageStatsReset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	memset(stages, 0, sizeof(stages));
+	k_spin_unlock(&lock, key);
+}
+
+uint32_t stageStatsFrequency(void)
+{
+#if defined(CONFIG_TIMING_FUNCTIONS)
+	return (uint32_t)timing_freq_get();
+#else
+	return sys_clock_hw_cycles_per_sec();
+#endif
+}
+
+const char *stageName(enum stage stage)
+{
+	return stage < STAGE_COUNT ? stage_names[stage] : "?";
+}
+
+static int stageStatsInit(void)
+{
+#if defined(CONFIG_TIMING_FUNCTIONS)
+	timing_init();
+	timing_start();
+#endif
+	return 0;
+}
+
+SYS_INIT(stageStatsInit, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if defined(CONFIG_APP_STAGE_STATS_SHELL)
+
+static int cmdStagesShow(const struct shell *sh, size_t argc, char **argv)
+{
+	uint32_t mhz = stageStatsFrequency() / 1000000;
+
+	shell_print(sh, "cycles at %u Hz; histogram buckets < 256, 1k, 4k, 16k, 64k, 256k, 1M, more",
+		    stageStatsFrequency());
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		struct stage_stats s;
+
+		stageStatsGet(i, &s);
+		shell_print(sh, "%-9s n %u min %u max %u mean %u (%u us)", stageName(i), s.count,
+			    s.min, s.max, s.mean, mhz ? s.mean / mhz : 0);
+		shell_print(sh, "          %u %u %u %u %u %u %u %u", s.histogram[0], s.histogram[1],
+			    s.histogram[2], s.histogram[3], s.histogram[4], s.histogram[5],
+			    s.histogram[6], s.histogram[7]);
+	}
+	return 0;
+}
+
+static int cmdStagesReset(const struct shell *sh, size_t argc, char **argv)
+{
+	stageStatsReset();
+	shell_print(sh, "stage statistics cleared");
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_stages,
+	SHELL_CMD(show, NULL, "Print min/max/mean and histogram per stage", cmdStagesShow),
+	SHELL_CMD(reset, NULL, "Clear all stage statistics", cmdStagesReset),
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(stages, &sub_stages, "Stage timing statistics", cmdStagesShow);
+
+#endif